@@ -156,3 +156,41 @@ int barebox_register_filedev(struct hf_info *hf)
 {
 	return of_register_fixup(of_hostfile_fixup, hf);
 }
+
+static int of_hostfile_nand_fixup(struct device_node *root, void *ctx)
+{
+	struct hf_info *hf = ctx;
+	struct device_node *node;
+	int ret;
+
+	node = of_new_node(root, hf->devname);
+
+	ret = of_set_property(node, "compatible", "barebox,sandbox-nand",
+			      strlen("barebox,sandbox-nand") + 1, 1);
+	if (ret)
+		return ret;
+
+	ret = of_property_write_u32(node, "barebox,fd", hf->fd);
+	if (ret)
+		return ret;
+
+	ret = of_set_property(node, "barebox,filename", hf->filename,
+			      strlen(hf->filename) + 1, 1);
+	if (ret)
+		return ret;
+
+	ret = of_property_write_u64(node, "barebox,size", hf->size);
+	if (ret)
+		return ret;
+
+	if (hf->options)
+		ret = of_set_property(node, "barebox,options", hf->options,
+				      strlen(hf->options) + 1, 1);
+
+	return ret;
+}
+
+int barebox_register_nanddev(struct hf_info *hf)
+{
+	return of_register_fixup(of_hostfile_nand_fixup, hf);
+}
@@ -0,0 +1,63 @@
+/*
+ * smp.c - emulate secondary CPUs for smp_work with host threads
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <init.h>
+#include <smp_work.h>
+#include <mach/linux.h>
+
+/* like the i.MX6Q we are usually used to test for: four cores */
+#define SANDBOX_SECONDARY_CPUS	3
+
+struct sandbox_cpu {
+	struct smp_work_cpu cpu;
+	void *thread;
+};
+
+static struct sandbox_cpu sandbox_cpus[SANDBOX_SECONDARY_CPUS];
+
+static int sandbox_cpu_run(void *arg)
+{
+	struct sandbox_cpu *scpu = arg;
+
+	return smp_work_secondary(&scpu->cpu);
+}
+
+static void sandbox_cpu_kick(struct smp_work_cpu *cpu)
+{
+	struct sandbox_cpu *scpu = container_of(cpu, struct sandbox_cpu, cpu);
+
+	linux_thread_kick(scpu->thread);
+}
+
+static int sandbox_smp_init(void)
+{
+	int i, n;
+
+	n = min(linux_nr_cpus() - 1, SANDBOX_SECONDARY_CPUS);
+
+	for (i = 0; i < n; i++) {
+		struct sandbox_cpu *scpu = &sandbox_cpus[i];
+
+		scpu->cpu.id = i + 1;
+		scpu->cpu.kick = sandbox_cpu_kick;
+		scpu->thread = linux_thread_start(sandbox_cpu_run, scpu);
+		if (!scpu->thread)
+			break;
+
+		smp_work_add_cpu(&scpu->cpu);
+	}
+
+	return 0;
+}
+core_initcall(sandbox_smp_init);
@@ -0,0 +1,25 @@
+/*
+ * Register the PCLMULQDQ based CRC-32 of the sandbox host
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <init.h>
+#include <mach/linux.h>
+
+static int crc32_pclmul_init(void)
+{
+	if (!linux_has_pclmul())
+		return 0;
+
+	return crc32_register_accel(linux_crc32_pclmul);
+}
+core_initcall(crc32_pclmul_init);
@@ -7,8 +7,10 @@ struct hf_info {
 	size_t size;
 	const char *devname;
 	const char *filename;
+	const char *options;
 };
 
 int barebox_register_filedev(struct hf_info *hf);
+int barebox_register_nanddev(struct hf_info *hf);
 
 #endif /* __ASM_ARCH_HOSTFILE_H */
@@ -19,6 +19,17 @@ void __attribute__((noreturn)) linux_exit(void);
 
 int linux_execve(const char * filename, char *const argv[], char *const envp[]);
 
+int linux_has_sha_ni(void);
+void linux_sha1_block(uint32_t *state, const void *data, unsigned int blocks);
+void linux_sha256_block(uint32_t *state, const void *data, unsigned int blocks);
+
+int linux_nr_cpus(void);
+void *linux_thread_start(int (*fn)(void *arg), void *arg);
+void linux_thread_kick(void *thread);
+
+int linux_has_pclmul(void);
+uint32_t linux_crc32_pclmul(uint32_t crc, const void *data, unsigned int len);
+
 int barebox_register_console(char *name_template, int stdinfd, int stdoutfd);
 
 int barebox_register_dtb(const void *dtb);
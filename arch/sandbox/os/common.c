@@ -273,6 +273,61 @@ err_out:
 	return -1;
 }
 
+/* parses: "[devname=]filename[,option=value...]" */
+static int add_nand(char *str, int *devname_number)
+{
+	struct hf_info *hf = calloc(1, sizeof(struct hf_info));
+	char *filename, *devname, *options;
+	char tmp[16];
+	struct stat s;
+	int fd, ret;
+
+	if (!hf)
+		return -1;
+
+	options = strchr(str, ',');
+	if (options)
+		*options++ = 0;
+
+	devname = strtok(str, "=");
+	filename = strtok(NULL, "=");
+	if (!filename) {
+		filename = devname;
+		snprintf(tmp, sizeof(tmp), "nand%d", (*devname_number)++);
+		devname = strdup(tmp);
+	}
+
+	printf("add %s backed by file %s\n", devname, filename);
+
+	fd = open(filename, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		perror("open");
+		goto err_out;
+	}
+
+	if (fstat(fd, &s)) {
+		perror("fstat");
+		goto err_out;
+	}
+
+	hf->fd = fd;
+	hf->size = s.st_size;
+	hf->filename = filename;
+	hf->devname = strdup(devname);
+	hf->options = options;
+
+	ret = barebox_register_nanddev(hf);
+	if (ret)
+		goto err_out;
+	return 0;
+
+err_out:
+	if (fd > 0)
+		close(fd);
+	free(hf);
+	return -1;
+}
+
 static int add_dtb(const char *file)
 {
 	struct stat s;
@@ -321,17 +376,18 @@ static struct option long_options[] = {
 	{"stdin",  1, 0, 'I'},
 	{"xres",  1, 0, 'x'},
 	{"yres",  1, 0, 'y'},
+	{"nand",  1, 0, 'n'},
 	{0, 0, 0, 0},
 };
 
-static const char optstring[] = "hm:i:e:d:O:I:x:y:";
+static const char optstring[] = "hm:i:e:d:O:I:x:y:n:";
 
 int main(int argc, char *argv[])
 {
 	void *ram;
 	int opt, ret, fd;
 	int malloc_size = CONFIG_MALLOC_SIZE;
-	int fdno = 0, envno = 0, option_index = 0;
+	int fdno = 0, envno = 0, nandno = 0, option_index = 0;
 
 	while (1) {
 		option_index = 0;
@@ -352,6 +408,8 @@ int main(int argc, char *argv[])
 			break;
 		case 'e':
 			break;
+		case 'n':
+			break;
 		case 'd':
 			ret = add_dtb(optarg);
 			if (ret) {
@@ -421,6 +479,11 @@ int main(int argc, char *argv[])
 			if (ret)
 				exit(1);
 			break;
+		case 'n':
+			ret = add_nand(optarg, &nandno);
+			if (ret)
+				exit(1);
+			break;
 		default:
 			break;
 		}
@@ -464,7 +527,15 @@ static void print_usage(const char *prgname)
 "  -I, --stdin=<file>   Register a file as a console capable of doing stdin.\n"
 "                       <file> can be a regular file or a FIFO.\n"
 "  -x, --xres=<res>     SDL width.\n"
-"  -y, --yres=<res>     SDL height.\n",
+"  -y, --yres=<res>     SDL height.\n"
+"  -n, --nand=<file>[,<option>=<value>...]\n"
+"                       Simulate a NAND flash backed by <file>. The file is\n"
+"                       created if necessary. Options are pagesize, oobsize,\n"
+"                       pages (per block), blocks, badblocks (colon separated\n"
+"                       list), bitflips (per page read), ecc (soft, bch<n>),\n"
+"                       tR, tRCBSY, tPROG, tBERS (in us), readcache (0 to\n"
+"                       disable the read cache commands) and delay (1 to\n"
+"                       really wait).\n",
 	prgname
 	);
 }
@@ -0,0 +1,126 @@
+/*
+ * CRC-32 (IEEE 802.3) using the x86 carry-less multiplication instruction
+ *
+ * This is based on "Fast CRC Computation for Generic Polynomials Using
+ * PCLMULQDQ Instruction" by Intel and the folding constants of the Linux
+ * kernel crc32-pclmul implementation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define PCLMUL_TARGET __attribute__((target("pclmul,sse4.1")))
+
+int linux_has_pclmul(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+
+	/* PCLMULQDQ and SSE4.1 */
+	return (ecx & (1 << 1)) && (ecx & (1 << 19));
+}
+
+/* fold 128 bits of the remainder across 128 bits of data */
+PCLMUL_TARGET
+static inline __m128i crc32_fold(__m128i x, __m128i k, __m128i data)
+{
+	__m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+	__m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+
+	return _mm_xor_si128(_mm_xor_si128(lo, hi), data);
+}
+
+#define LOAD(p)	_mm_loadu_si128((const __m128i *)(p))
+
+/*
+ * Compute the CRC-32 of @len bytes without pre and post conditioning.
+ * @len must be a multiple of 16 and at least 64.
+ */
+PCLMUL_TARGET
+uint32_t linux_crc32_pclmul(uint32_t crc, const void *data, unsigned int len)
+{
+	const __m128i r2r1 = _mm_set_epi64x(0x1c6e41596ULL, 0x154442bd4ULL);
+	const __m128i r4r3 = _mm_set_epi64x(0x0ccaa009eULL, 0x1751997d0ULL);
+	const __m128i r5 = _mm_set_epi64x(0, 0x163cd6124ULL);
+	const __m128i rupoly = _mm_set_epi64x(0x1f7011641ULL, 0x1db710641ULL);
+	const __m128i mask32 = _mm_set_epi32(0, 0, 0, ~0);
+	const uint8_t *p = data;
+	__m128i x1, x2, x3, x4;
+
+	x1 = _mm_xor_si128(LOAD(p), _mm_cvtsi32_si128(crc));
+	x2 = LOAD(p + 16);
+	x3 = LOAD(p + 32);
+	x4 = LOAD(p + 48);
+	p += 64;
+	len -= 64;
+
+	/* fold 64 bytes at a time */
+	while (len >= 64) {
+		x1 = crc32_fold(x1, r2r1, LOAD(p));
+		x2 = crc32_fold(x2, r2r1, LOAD(p + 16));
+		x3 = crc32_fold(x3, r2r1, LOAD(p + 32));
+		x4 = crc32_fold(x4, r2r1, LOAD(p + 48));
+		p += 64;
+		len -= 64;
+	}
+
+	/* fold into 128 bits */
+	x1 = crc32_fold(x1, r4r3, x2);
+	x1 = crc32_fold(x1, r4r3, x3);
+	x1 = crc32_fold(x1, r4r3, x4);
+
+	while (len >= 16) {
+		x1 = crc32_fold(x1, r4r3, LOAD(p));
+		p += 16;
+		len -= 16;
+	}
+
+	/* fold 128 to 64 bits, this also appends 32 zero bits */
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8),
+			   _mm_clmulepi64_si128(r4r3, x1, 0x01));
+
+	/* final 32 bit fold */
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask32);
+	x1 = _mm_clmulepi64_si128(x1, r5, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* bit reflected Barrett reduction from 64 to 32 bits */
+	x2 = x1;
+	x1 = _mm_and_si128(x1, mask32);
+	x1 = _mm_clmulepi64_si128(x1, rupoly, 0x10);
+	x1 = _mm_and_si128(x1, mask32);
+	x1 = _mm_clmulepi64_si128(x1, rupoly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return _mm_extract_epi32(x1, 1);
+}
+
+#else
+
+int linux_has_pclmul(void)
+{
+	return 0;
+}
+
+uint32_t linux_crc32_pclmul(uint32_t crc, const void *data, unsigned int len)
+{
+	return crc;
+}
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * SHA-1 and SHA-256 block functions using the x86 SHA extensions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SHA_NI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+int linux_has_sha_ni(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+	/* SHA extensions: CPUID.(EAX=7,ECX=0):EBX[bit 29] */
+	if (!(ebx & (1 << 29)))
+		return 0;
+
+	__cpuid(1, eax, ebx, ecx, edx);
+
+	/* SSSE3 and SSE4.1 */
+	return (ecx & (1 << 9)) && (ecx & (1 << 19));
+}
+
+/* four rounds of SHA-1 with message group @i using round function @f */
+#define SHA1_ROUNDS4(i, f)						\
+	do {								\
+		__m128i *m = &msg[(i) & 3];				\
+									\
+		if ((i) < 4) {						\
+			*m = _mm_loadu_si128((const __m128i *)(p + 16 * (i))); \
+			*m = _mm_shuffle_epi8(*m, mask);		\
+		} else {						\
+			*m = _mm_sha1msg1_epu32(*m, msg[((i) + 1) & 3]); \
+			*m = _mm_xor_si128(*m, msg[((i) + 2) & 3]);	\
+			*m = _mm_sha1msg2_epu32(*m, msg[((i) + 3) & 3]); \
+		}							\
+									\
+		if ((i) == 0)						\
+			e = _mm_add_epi32(e_next, *m);			\
+		else							\
+			e = _mm_sha1nexte_epu32(e_next, *m);		\
+									\
+		e_next = abcd;						\
+		abcd = _mm_sha1rnds4_epu32(abcd, e, f);			\
+	} while (0)
+
+SHA_NI_TARGET
+void linux_sha1_block(uint32_t *state, const void *data, unsigned int blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+					    0x08090a0b0c0d0e0fULL);
+	const uint8_t *p = data;
+	__m128i abcd, abcd_save, e, e_save, e_next, msg[4];
+	int i;
+
+	abcd = _mm_loadu_si128((const __m128i *)state);
+	abcd = _mm_shuffle_epi32(abcd, 0x1b);
+	e_save = _mm_set_epi32(state[4], 0, 0, 0);
+
+	while (blocks--) {
+		abcd_save = abcd;
+		e_next = e_save;
+
+		for (i = 0; i < 5; i++)
+			SHA1_ROUNDS4(i, 0);
+		for (; i < 10; i++)
+			SHA1_ROUNDS4(i, 1);
+		for (; i < 15; i++)
+			SHA1_ROUNDS4(i, 2);
+		for (; i < 20; i++)
+			SHA1_ROUNDS4(i, 3);
+
+		e_save = _mm_sha1nexte_epu32(e_next, e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+
+		p += 64;
+	}
+
+	abcd = _mm_shuffle_epi32(abcd, 0x1b);
+	_mm_storeu_si128((__m128i *)state, abcd);
+	state[4] = _mm_extract_epi32(e_save, 3);
+}
+
+static const uint32_t sha256_k[64] __attribute__((aligned(16))) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+SHA_NI_TARGET
+void linux_sha256_block(uint32_t *state, const void *data, unsigned int blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					    0x0405060700010203ULL);
+	const uint8_t *p = data;
+	__m128i abef, cdgh, abef_save, cdgh_save, tmp, m, msg[4];
+	int i;
+
+	/* state is kept as ABEF/CDGH as required by sha256rnds2 */
+	tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+	cdgh = _mm_loadu_si128((const __m128i *)&state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xb1);
+	cdgh = _mm_shuffle_epi32(cdgh, 0x1b);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+	while (blocks--) {
+		abef_save = abef;
+		cdgh_save = cdgh;
+
+		for (i = 0; i < 16; i++) {
+			__m128i *w = &msg[i & 3];
+
+			if (i < 4) {
+				*w = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+				*w = _mm_shuffle_epi8(*w, mask);
+			} else {
+				*w = _mm_sha256msg1_epu32(*w, msg[(i + 1) & 3]);
+				*w = _mm_add_epi32(*w,
+					_mm_alignr_epi8(msg[(i + 3) & 3],
+							msg[(i + 2) & 3], 4));
+				*w = _mm_sha256msg2_epu32(*w, msg[(i + 3) & 3]);
+			}
+
+			m = _mm_add_epi32(*w,
+				_mm_load_si128((const __m128i *)&sha256_k[4 * i]));
+			cdgh = _mm_sha256rnds2_epu32(cdgh, abef, m);
+			m = _mm_shuffle_epi32(m, 0x0e);
+			abef = _mm_sha256rnds2_epu32(abef, cdgh, m);
+		}
+
+		abef = _mm_add_epi32(abef, abef_save);
+		cdgh = _mm_add_epi32(cdgh, cdgh_save);
+
+		p += 64;
+	}
+
+	tmp = _mm_shuffle_epi32(abef, 0x1b);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+	abef = _mm_blend_epi16(tmp, cdgh, 0xf0);
+	cdgh = _mm_alignr_epi8(cdgh, tmp, 8);
+
+	_mm_storeu_si128((__m128i *)&state[0], abef);
+	_mm_storeu_si128((__m128i *)&state[4], cdgh);
+}
+
+#else
+
+int linux_has_sha_ni(void)
+{
+	return 0;
+}
+
+void linux_sha1_block(uint32_t *state, const void *data, unsigned int blocks)
+{
+}
+
+void linux_sha256_block(uint32_t *state, const void *data, unsigned int blocks)
+{
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Host threads emulating secondary CPUs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * These are host includes. Never include any barebox header
+ * files here...
+ */
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct linux_thread {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int kicked;
+	int (*fn)(void *arg);
+	void *arg;
+};
+
+static void *linux_thread_main(void *data)
+{
+	struct linux_thread *t = data;
+
+	for (;;) {
+		while (t->fn(t->arg))
+			;
+
+		pthread_mutex_lock(&t->lock);
+		while (!t->kicked)
+			pthread_cond_wait(&t->cond, &t->lock);
+		t->kicked = 0;
+		pthread_mutex_unlock(&t->lock);
+	}
+
+	return NULL;
+}
+
+int linux_nr_cpus(void)
+{
+	return sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+/*
+ * Start a thread calling @fn until it returns 0 each time it has been
+ * kicked with linux_thread_kick().
+ */
+void *linux_thread_start(int (*fn)(void *arg), void *arg)
+{
+	struct linux_thread *t;
+	sigset_t set, old;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+
+	t->fn = fn;
+	t->arg = arg;
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_cond_init(&t->cond, NULL);
+
+	/* signals are for the barebox thread only */
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &old);
+
+	if (pthread_create(&t->thread, NULL, linux_thread_main, t)) {
+		free(t);
+		t = NULL;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	return t;
+}
+
+void linux_thread_kick(void *thread)
+{
+	struct linux_thread *t = thread;
+
+	pthread_mutex_lock(&t->lock);
+	t->kicked = 1;
+	pthread_cond_signal(&t->cond);
+	pthread_mutex_unlock(&t->lock);
+}
@@ -0,0 +1,69 @@
+/*
+ * bootprofile.c - show where the time during boot was spent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <common.h>
+#include <command.h>
+#include <bootprofile.h>
+#include <getopt.h>
+#include <errno.h>
+
+static int do_bootprofile(int argc, char *argv[])
+{
+	int opt, ret;
+	uint64_t threshold = 0;
+	const char *filename = NULL;
+
+	while ((opt = getopt(argc, argv, "t:f:")) > 0) {
+		switch (opt) {
+		case 't':
+			threshold = simple_strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case 'f':
+			filename = optarg;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (filename) {
+		ret = bootprofile_export(filename);
+		if (ret) {
+			printf("cannot write %s: %s\n", filename,
+					strerror(-ret));
+			return COMMAND_ERROR;
+		}
+
+		return 0;
+	}
+
+	bootprofile_print(threshold);
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(bootprofile)
+BAREBOX_CMD_HELP_TEXT("Show the time spent in initcalls, device probes, deferred probe")
+BAREBOX_CMD_HELP_TEXT("passes and scripts until barebox reached the shell.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-t USECS", "only show events which took at least USECS")
+BAREBOX_CMD_HELP_OPT ("-f FILE", "write a boot chart for Linux' scripts/bootgraph.pl to FILE")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(bootprofile)
+	.cmd		= do_bootprofile,
+	BAREBOX_CMD_DESC("show boot time profile")
+	BAREBOX_CMD_OPTS("[-tf]")
+	BAREBOX_CMD_GROUP(CMD_GRP_INFO)
+	BAREBOX_CMD_HELP(cmd_bootprofile_help)
+BAREBOX_CMD_END
@@ -14,6 +14,7 @@
 #include <digest.h>
 #include <getopt.h>
 #include <libfile.h>
+#include <clock.h>
 
 #include "internal.h"
 
@@ -88,13 +89,17 @@ static int do_digest(int argc, char *argv[])
 	size_t digestlen = 0;
 	char *algo = NULL;
 	int opt;
+	int bench = 0;
 	int ret = COMMAND_ERROR;
 
 	if (argc < 2)
 		return COMMAND_ERROR_USAGE;
 
-	while((opt = getopt(argc, argv, "a:k:K:s:S:")) > 0) {
+	while((opt = getopt(argc, argv, "a:bk:K:s:S:")) > 0) {
 		switch(opt) {
+		case 'b':
+			bench = 1;
+			break;
 		case 'k':
 			key = optarg;
 			keylen = strlen(key);
@@ -115,6 +120,13 @@ static int do_digest(int argc, char *argv[])
 		}
 	}
 
+	if (bench) {
+		ret = digest_algo_benchmark(algo, SECOND);
+		if (ret == -ENOENT)
+			eprintf("algo '%s' not found\n", algo);
+		return ret ? COMMAND_ERROR : COMMAND_SUCCESS;
+	}
+
 	if (!algo)
 		return COMMAND_ERROR_USAGE;
 
@@ -185,6 +197,7 @@ BAREBOX_CMD_HELP_START(digest)
 BAREBOX_CMD_HELP_TEXT("Calculate a digest over a FILE or a memory area.")
 BAREBOX_CMD_HELP_TEXT("Options:")
 BAREBOX_CMD_HELP_OPT ("-a <algo>\t",  "hash or signature algorithm to use")
+BAREBOX_CMD_HELP_OPT ("-b\t",         "benchmark all implementations of <algo> (or all algorithms)")
 BAREBOX_CMD_HELP_OPT ("-k <key>\t",   "use supplied <key> (ASCII or hex) for MAC")
 BAREBOX_CMD_HELP_OPT ("-K <file>\t",  "use key from <file> (binary) for MAC")
 BAREBOX_CMD_HELP_OPT ("-s <hex>\t",   "verify data against supplied <hex> (hash, MAC or signature)")
@@ -194,7 +207,7 @@ BAREBOX_CMD_HELP_END
 BAREBOX_CMD_START(digest)
 	.cmd		= do_digest,
 	BAREBOX_CMD_DESC("calculate digest")
-	BAREBOX_CMD_OPTS("-a <algo> [-k <key> | -K <file>] [-s <sig> | -S <file>] FILE|AREA")
+	BAREBOX_CMD_OPTS("-a <algo> [-k <key> | -K <file>] [-s <sig> | -S <file>] FILE|AREA | [-a <algo>] -b")
 	BAREBOX_CMD_GROUP(CMD_GRP_FILE)
 	BAREBOX_CMD_HELP(cmd_digest_help)
 	BAREBOX_CMD_USAGE(prints_algo_help)
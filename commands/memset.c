@@ -32,17 +32,35 @@
 #include <getopt.h>
 #include <linux/stat.h>
 #include <xfuncs.h>
+#include <memory.h>
+#include <smp_work.h>
+#include <linux/sizes.h>
 
 extern char *mem_rw_buf;
 
+static int range_in_sdram(unsigned long start, unsigned long size)
+{
+	struct memory_bank *bank;
+
+	for_each_memory_bank(bank) {
+		if (start >= bank->start &&
+				start - bank->start + size <= bank->size)
+			return 1;
+	}
+
+	return 0;
+}
+
 static int do_memset(int argc, char *argv[])
 {
 	loff_t	s, c, n;
 	int     fd;
 	char   *buf;
-	int	mode  = O_RWSIZE_1;
+	int	mode  = 0;
+	int	width;
 	int     ret = 1;
 	char	*file = "/dev/mem";
+	struct stat st;
 
 	if (mem_parse_options(argc, argv, "bwlqd:", &mode, NULL, &file,
 			NULL) < 0)
@@ -55,10 +73,31 @@ static int do_memset(int argc, char *argv[])
 	c = strtoull_suffix(argv[optind + 1], NULL, 0);
 	n = strtoull_suffix(argv[optind + 2], NULL, 0);
 
+	width = mode;
+	if (!mode)
+		mode = O_RWSIZE_1;
+
 	fd = open_and_lseek(file, mode | O_WRONLY, s);
 	if (fd < 0)
 		return 1;
 
+	buf = NULL;
+
+	/*
+	 * Large fills of SDRAM are split over all CPUs. This doesn't keep to
+	 * any access width, so only do it when none was requested.
+	 */
+	if (!width && n >= SZ_1M && !fstat(fd, &st) && s + n <= st.st_size) {
+		void *map = memmap(fd, PROT_WRITE);
+
+		if (map != (void *)-1 &&
+				range_in_sdram((unsigned long)map + s, n)) {
+			smp_memset(map + s, c, n);
+			ret = 0;
+			goto out;
+		}
+	}
+
 	buf = xmalloc(RW_BUF_SIZE);
 	memset(buf, c, RW_BUF_SIZE);
 
@@ -277,7 +277,7 @@ static int do_of_property(int argc, char *argv[])
 		}
 
 		if (pp) {
-			free(pp->value);
+			of_free(pp->value);
 
 			/* limit property data to the actual size */
 			if (len) {
@@ -288,6 +288,8 @@ static int do_of_property(int argc, char *argv[])
 			}
 
 			pp->length = len;
+
+			of_tree_changed(node);
 		} else {
 			pp = of_new_property(node, propname, data, len);
 			if (!pp) {
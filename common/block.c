@@ -21,7 +21,10 @@
 #include <malloc.h>
 #include <linux/err.h>
 #include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/hash.h>
 #include <dma.h>
+#include <param.h>
 
 #define BLOCKSIZE(blk)	(1 << blk->blockbits)
 
@@ -30,7 +33,7 @@ LIST_HEAD(block_device_list);
 /* a chunk of contigous data */
 struct chunk {
 	void *data; /* data buffer */
-	int block_start; /* first block in this chunk */
+	int block_start; /* first block in this chunk, -1 if unused */
 	int dirty; /* need to write back to device */
 	int num; /* number of chunk, debugging only */
 	struct list_head list;
@@ -38,22 +41,79 @@ struct chunk {
 
 #define BUFSIZE (PAGE_SIZE * 16)
 
+/*
+ * The cache is organized as a set associative cache. A chunk can only live
+ * in the set its first block hashes to, so a lookup has to scan at most
+ * BLOCK_CACHE_WAYS chunks regardless of the overall cache size. Each set
+ * keeps its chunks in LRU order.
+ */
+#define BLOCK_CACHE_WAYS		4
+#define BLOCK_CACHE_DEFAULT_CHUNKS	8
+
+/*
+ * Like dma_alloc(), but fails instead of panicking, as the cache and
+ * read-ahead sizes can be set by the user.
+ */
+static void *block_dma_alloc(size_t size)
+{
+	return memalign(DMA_ALIGNMENT, ALIGN(size, DMA_ALIGNMENT));
+}
+
+static struct list_head *chunk_set(struct block_device *blk, int block)
+{
+	int block_start = block & ~blk->blkmask;
+
+	if (!blk->cache_set_bits)
+		return &blk->cache_sets[0];
+
+	return &blk->cache_sets[hash_32(block_start, blk->cache_set_bits)];
+}
+
+static void block_readahead_invalidate_range(struct block_device *blk,
+		int block, int num_blocks);
+
+/*
+ * Write a chunk back to the device if it is dirty
+ */
+static int chunk_flush(struct block_device *blk, struct chunk *chunk)
+{
+	size_t num_blocks;
+	int ret;
+
+	if (!chunk->dirty)
+		return 0;
+
+	num_blocks = min(blk->rdbufsize, blk->num_blocks - chunk->block_start);
+
+	ret = blk->ops->write(blk, chunk->data, chunk->block_start, num_blocks);
+	if (ret)
+		return ret;
+
+	chunk->dirty = 0;
+
+	/*
+	 * A read-ahead window may have been filled from the device while
+	 * the chunk was dirty. It was hidden by the chunk so far.
+	 */
+	block_readahead_invalidate_range(blk, chunk->block_start, num_blocks);
+
+	return 0;
+}
+
 /*
  * Write all dirty chunks back to the device
  */
 static int writebuffer_flush(struct block_device *blk)
 {
 	struct chunk *chunk;
+	int i;
 
 	if (!IS_ENABLED(CONFIG_BLOCK_WRITE))
 		return 0;
 
-	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
-		if (chunk->dirty) {
-			blk->ops->write(blk, chunk->data, chunk->block_start, blk->rdbufsize);
-			chunk->dirty = 0;
-		}
-	}
+	for (i = 0; i < (1 << blk->cache_set_bits); i++)
+		list_for_each_entry(chunk, &blk->cache_sets[i], list)
+			chunk_flush(blk, chunk);
 
 	if (blk->ops->flush)
 		return blk->ops->flush(blk);
@@ -67,16 +127,17 @@ static int writebuffer_flush(struct block_device *blk)
  */
 static struct chunk *chunk_get_cached(struct block_device *blk, int block)
 {
+	struct list_head *set = chunk_set(blk, block);
+	int block_start = block & ~blk->blkmask;
 	struct chunk *chunk;
 
-	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
-		if (block >= chunk->block_start &&
-				block < chunk->block_start + blk->rdbufsize) {
+	list_for_each_entry(chunk, set, list) {
+		if (chunk->block_start == block_start) {
 			debug("%s: found %d in %d\n", __func__, block, chunk->num);
 			/*
-			 * move most recently used entry to the head of the list
+			 * move most recently used entry to the head of the set
 			 */
-			list_move(&chunk->list, &blk->buffered_blocks);
+			list_move(&chunk->list, set);
 			return chunk;
 		}
 	}
@@ -100,29 +161,19 @@ static void *block_get_cached(struct block_device *blk, int block)
 }
 
 /*
- * Get a data chunk, either from the idle list or if the idle list
- * is empty, the least recently used is written back to disk and
- * returned.
+ * Get a data chunk for the set a given block belongs to. This is the least
+ * recently used chunk of the set which is written back to disk if necessary.
  */
-static struct chunk *get_chunk(struct block_device *blk)
+static struct chunk *get_chunk(struct block_device *blk, int block)
 {
+	struct list_head *set = chunk_set(blk, block);
 	struct chunk *chunk;
 
-	if (list_empty(&blk->idle_blocks)) {
-		/* use last entry which is the most unused */
-		chunk = list_last_entry(&blk->buffered_blocks, struct chunk, list);
-		if (chunk->dirty) {
-			size_t num_blocks = min(blk->rdbufsize,
-					blk->num_blocks - chunk->block_start);
-			blk->ops->write(blk, chunk->data, chunk->block_start,
-					num_blocks);
-			chunk->dirty = 0;
-		}
-
-		list_del(&chunk->list);
-	} else {
-		chunk = list_first_entry(&blk->idle_blocks, struct chunk, list);
-		list_del(&chunk->list);
+	/* use last entry which is the most unused */
+	chunk = list_last_entry(set, struct chunk, list);
+	if (chunk->block_start >= 0) {
+		chunk_flush(blk, chunk);
+		blk->cache_evictions++;
 	}
 
 	return chunk;
@@ -135,11 +186,12 @@ static struct chunk *get_chunk(struct block_device *blk)
  */
 static int block_cache(struct block_device *blk, int block)
 {
+	struct list_head *set = chunk_set(blk, block);
 	struct chunk *chunk;
 	size_t num_blocks;
 	int ret;
 
-	chunk = get_chunk(blk);
+	chunk = get_chunk(blk, block);
 	chunk->block_start = block & ~blk->blkmask;
 
 	debug("%s: %d to %d\n", __func__, chunk->block_start,
@@ -149,19 +201,351 @@ static int block_cache(struct block_device *blk, int block)
 
 	ret = blk->ops->read(blk, chunk->data, chunk->block_start, num_blocks);
 	if (ret) {
-		list_add_tail(&chunk->list, &blk->idle_blocks);
+		chunk->block_start = -1;
+		list_move_tail(&chunk->list, set);
+		return ret;
+	}
+	list_move(&chunk->list, set);
+
+	return 0;
+}
+
+static void block_cache_free(struct list_head *sets, int num_sets)
+{
+	struct chunk *chunk, *tmp;
+	int i;
+
+	for (i = 0; i < num_sets; i++) {
+		list_for_each_entry_safe(chunk, tmp, &sets[i], list) {
+			dma_free(chunk->data);
+			free(chunk);
+		}
+	}
+
+	free(sets);
+}
+
+/*
+ * (Re)allocate the cache with space for @chunks chunks. The number of
+ * chunks is rounded down so that it fits into a power of two number of
+ * sets. The old cache is released, so it must have been flushed by the
+ * caller. If the buffers can't be allocated the old cache is kept.
+ */
+static int block_cache_init(struct block_device *blk, int chunks)
+{
+	struct list_head *sets;
+	int ways, num_sets, i;
+
+	if (chunks < 1)
+		return -EINVAL;
+
+	ways = min(chunks, BLOCK_CACHE_WAYS);
+	num_sets = 1 << ilog2(chunks / ways);
+
+	sets = xmalloc(sizeof(*sets) * num_sets);
+	for (i = 0; i < num_sets; i++)
+		INIT_LIST_HEAD(&sets[i]);
+
+	for (i = 0; i < num_sets * ways; i++) {
+		struct chunk *chunk = xzalloc(sizeof(*chunk));
+
+		chunk->data = block_dma_alloc(BUFSIZE);
+		if (!chunk->data) {
+			/* keep the old cache, if any */
+			free(chunk);
+			block_cache_free(sets, num_sets);
+			return -ENOMEM;
+		}
+
+		chunk->block_start = -1;
+		chunk->num = i;
+		list_add_tail(&chunk->list, &sets[i % num_sets]);
+	}
+
+	if (blk->cache_sets)
+		block_cache_free(blk->cache_sets, 1 << blk->cache_set_bits);
+
+	blk->cache_sets = sets;
+	blk->cache_set_bits = ilog2(num_sets);
+	blk->cache_chunks = num_sets * ways;
+
+	debug("%s: %d sets, %d ways\n", __func__, num_sets, ways);
+
+	return 0;
+}
+
+static int block_cache_chunks_set(struct param_d *p, void *priv)
+{
+	struct block_device *blk = priv;
+	int ret;
+
+	if (blk->cache_chunks < 1)
+		return -EINVAL;
+
+	ret = writebuffer_flush(blk);
+	if (ret)
+		return ret;
+
+	return block_cache_init(blk, blk->cache_chunks);
+}
+
+/*
+ * Several block devices may share a single device (i.e. the boot partitions
+ * of a MMC), so the parameter name is prefixed with the part of the cdev
+ * name following the dot, if any. Parameters without a setter are
+ * statistics and read only.
+ */
+static struct param_d *block_add_param(struct block_device *blk,
+		const char *name, int (*set)(struct param_d *p, void *priv),
+		int *value)
+{
+	const char *part = strchr(blk->cdev.name, '.');
+	struct param_d *p;
+	char *pname;
+
+	if (part)
+		pname = asprintf("%s_%s", part + 1, name);
+	else
+		pname = xstrdup(name);
+
+	p = dev_add_param_int(blk->dev, pname, set, NULL, value, "%d", blk);
+
+	free(pname);
+
+	if (IS_ERR(p))
+		return NULL;
+
+	if (!set)
+		p->flags |= PARAM_FLAG_RO;
+
+	return p;
+}
+
+/*
+ * Sequential reads are served from a read-ahead window. The window is
+ * a contiguous buffer filled with consecutive device requests of at most
+ * max_req_blocks blocks. Its size starts at two chunks and doubles with
+ * each refill as long as the access pattern stays sequential, up to the
+ * readahead_kb parameter. When the device supports asynchronous requests
+ * the next part of a window is read in the background while the reader
+ * processes the current one, and the first part of the window following
+ * the current one is read as well, so that the device stays busy.
+ * The windows never contain stale data: they are invalidated on writes,
+ * the chunk cache is always consulted first and windows overlapping a
+ * chunk are invalidated when the chunk is written back.
+ */
+#define BLOCK_READAHEAD_DEFAULT_KB	512
+
+static int block_readahead_max(struct block_device *blk)
+{
+	return (blk->readahead_kb << 10) >> blk->blockbits;
+}
+
+static void block_window_drop(struct block_device *blk,
+		struct block_window *w)
+{
+	if (w->req.num_blocks)
+		block_complete(blk, &w->req);
+
+	w->req.num_blocks = 0;
+	w->num_blocks = 0;
+	w->valid = 0;
+}
+
+/*
+ * Request the part of a window following the blocks read so far
+ */
+static int block_window_submit(struct block_device *blk,
+		struct block_window *w)
+{
+	struct block_request *req = &w->req;
+	int ret;
+
+	req->block = w->block + w->valid;
+	req->num_blocks = min(w->num_blocks - w->valid, blk->max_req_blocks);
+	req->buf = w->buf + (w->valid << blk->blockbits);
+
+	debug("%s: %d blocks at %d\n", __func__, req->num_blocks, req->block);
+
+	ret = block_submit(blk, req);
+	if (ret)
+		req->num_blocks = 0;
+
+	return ret;
+}
+
+/*
+ * Wait until a window has been read up to @block. The window is dropped
+ * on errors.
+ */
+static int block_window_read(struct block_device *blk,
+		struct block_window *w, int block)
+{
+	struct block_request *req = &w->req;
+	int ret;
+
+	while (block >= w->block + w->valid) {
+		if (!req->num_blocks) {
+			ret = block_window_submit(blk, w);
+			if (ret)
+				goto err;
+		}
+
+		ret = block_complete(blk, req);
+		if (ret)
+			goto err;
+
+		w->valid += req->num_blocks;
+		req->num_blocks = 0;
+	}
+
+	/* errors show up when the reader gets there */
+	if (blk->ops->submit && !req->num_blocks && w->valid < w->num_blocks)
+		block_window_submit(blk, w);
+
+	return 0;
+err:
+	block_window_drop(blk, w);
+
+	return ret;
+}
+
+static void block_readahead_invalidate(struct block_device *blk)
+{
+	block_window_drop(blk, &blk->ra[0]);
+	block_window_drop(blk, &blk->ra[1]);
+}
+
+static void block_readahead_invalidate_range(struct block_device *blk,
+		int block, int num_blocks)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(blk->ra); i++) {
+		struct block_window *w = &blk->ra[i];
+
+		if (block < w->block + w->num_blocks &&
+				w->block < block + num_blocks)
+			block_window_drop(blk, w);
+	}
+}
+
+/*
+ * Start reading the window following the current one in the background
+ */
+static void block_readahead_prefetch(struct block_device *blk)
+{
+	struct block_window *cur = &blk->ra[blk->ra_cur];
+	struct block_window *next = &blk->ra[!blk->ra_cur];
+	int max = block_readahead_max(blk);
+	int block = cur->block + cur->num_blocks;
+
+	block_window_drop(blk, next);
+
+	if (!blk->ops->submit || block >= blk->num_blocks)
+		return;
+
+	if (!next->buf) {
+		next->buf = block_dma_alloc(max << blk->blockbits);
+		if (!next->buf)
+			return;
+	}
+
+	blk->ra_window = min(blk->ra_window * 2, max);
+
+	next->block = block;
+	next->num_blocks = min(blk->ra_window, blk->num_blocks - block);
+
+	block_window_submit(blk, next);
+}
+
+static void *block_get_readahead(struct block_device *blk, int block)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(blk->ra); i++) {
+		struct block_window *w = &blk->ra[i];
+
+		if (block < w->block || block >= w->block + w->num_blocks)
+			continue;
+
+		if (block_window_read(blk, w, block))
+			return NULL;
+
+		/*
+		 * The reader has reached the prefetched window, so the
+		 * current one can be reused for the next prefetch.
+		 */
+		if (i != blk->ra_cur) {
+			blk->ra_cur = i;
+			block_readahead_prefetch(blk);
+		}
+
+		return w->buf + ((block - w->block) << blk->blockbits);
+	}
+
+	return NULL;
+}
+
+static int block_readahead(struct block_device *blk, int block)
+{
+	struct block_window *w = &blk->ra[blk->ra_cur];
+	int max = block_readahead_max(blk);
+	int ret;
+
+	block_readahead_invalidate(blk);
+
+	if (!w->buf) {
+		w->buf = block_dma_alloc(max << blk->blockbits);
+		if (!w->buf)
+			return -ENOMEM;
+	}
+
+	blk->ra_window = clamp(blk->ra_window * 2, 2 * blk->rdbufsize, max);
+
+	w->block = block;
+	w->num_blocks = min(blk->ra_window, blk->num_blocks - block);
+
+	ret = block_window_read(blk, w, block);
+	if (ret)
 		return ret;
+
+	block_readahead_prefetch(blk);
+
+	return 0;
+}
+
+static void block_readahead_free(struct block_device *blk)
+{
+	int i;
+
+	block_readahead_invalidate(blk);
+	blk->ra_window = 0;
+
+	for (i = 0; i < ARRAY_SIZE(blk->ra); i++) {
+		dma_free(blk->ra[i].buf);
+		blk->ra[i].buf = NULL;
 	}
-	list_add(&chunk->list, &blk->buffered_blocks);
+}
+
+static int block_readahead_kb_set(struct param_d *p, void *priv)
+{
+	struct block_device *blk = priv;
+
+	if (blk->readahead_kb < 0)
+		return -EINVAL;
+
+	block_readahead_free(blk);
 
 	return 0;
 }
 
 /*
  * Get the data for a block, either from the cache or from
- * the device.
+ * the device. With @stream set the block is part of a sequential
+ * read and read-ahead is used on a cache miss.
  */
-static void *block_get(struct block_device *blk, int block)
+static void *block_get(struct block_device *blk, int block, int stream)
 {
 	void *outdata;
 	int ret;
@@ -170,8 +554,24 @@ static void *block_get(struct block_device *blk, int block)
 		return ERR_PTR(-ENXIO);
 
 	outdata = block_get_cached(blk, block);
-	if (outdata)
+	if (!outdata)
+		outdata = block_get_readahead(blk, block);
+	if (outdata) {
+		blk->cache_hits++;
 		return outdata;
+	}
+
+	blk->cache_misses++;
+
+	if (stream && block_readahead_max(blk) > 2 * blk->rdbufsize) {
+		ret = block_readahead(blk, block);
+		if (!ret)
+			return block_get_readahead(blk, block);
+
+		/* no memory for the window, read through the cache */
+		if (ret != -ENOMEM)
+			return ERR_PTR(ret);
+	}
 
 	ret = block_cache(blk, block);
 	if (ret)
@@ -184,6 +584,72 @@ static void *block_get(struct block_device *blk, int block)
 	return outdata;
 }
 
+/*
+ * Read blocks from the device with requests of at most max_req_blocks
+ * blocks.
+ */
+static int block_read_device(struct block_device *blk, void *buf, int block,
+		int num_blocks)
+{
+	while (num_blocks) {
+		int now = min(num_blocks, blk->max_req_blocks);
+		int ret;
+
+		ret = blk->ops->read(blk, buf, block, now);
+		if (ret)
+			return ret;
+
+		buf += now << blk->blockbits;
+		block += now;
+		num_blocks -= now;
+	}
+
+	return 0;
+}
+
+/*
+ * Read big ranges of blocks directly into the callers buffer, bypassing
+ * the cache. This is only done when the buffer is suitably aligned for
+ * DMA and only up to the next chunk that is cached, since cached data
+ * may be newer than the data on the device. Returns the number of blocks
+ * read, 0 if the blocks have to be read through the cache.
+ */
+static int block_read_direct(struct block_device *blk, void *buf, int block,
+		int num_blocks)
+{
+	int num = 0;
+	int ret;
+
+	if (num_blocks < blk->rdbufsize)
+		return 0;
+
+	if (!IS_ALIGNED((unsigned long)buf, DMA_ALIGNMENT))
+		return 0;
+
+	if (block >= blk->num_blocks)
+		return 0;
+
+	num_blocks = min(num_blocks, blk->num_blocks - block);
+
+	while (num < num_blocks) {
+		if (chunk_get_cached(blk, block + num))
+			break;
+		num = ((block + num) & ~blk->blkmask) + blk->rdbufsize - block;
+	}
+
+	num = min(num, num_blocks);
+	if (!num)
+		return 0;
+
+	debug("%s: %d blocks at %d\n", __func__, num, block);
+
+	ret = block_read_device(blk, buf, block, num);
+	if (ret)
+		return ret;
+
+	return num;
+}
+
 static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 		loff_t offset, unsigned long flags)
 {
@@ -191,11 +657,21 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 	unsigned long mask = BLOCKSIZE(blk) - 1;
 	unsigned long block = offset >> blk->blockbits;
 	size_t icount = count;
-	int blocks;
+	int blocks, stream;
+
+	/*
+	 * A read continuing where the last one stopped or a read spanning
+	 * more than a chunk is considered to be part of a sequential stream.
+	 */
+	stream = block == blk->seq_next || count > BUFSIZE;
+	if (!stream)
+		blk->ra_window = 0;
+
+	blk->seq_next = (offset + count) >> blk->blockbits;
 
 	if (offset & mask) {
 		size_t now = BLOCKSIZE(blk) - (offset & mask);
-		void *iobuf = block_get(blk, block);
+		void *iobuf = block_get(blk, block, stream);
 
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
@@ -211,20 +687,29 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 	blocks = count >> blk->blockbits;
 
 	while (blocks) {
-		void *iobuf = block_get(blk, block);
+		int now = block_read_direct(blk, buf, block, blocks);
 
-		if (IS_ERR(iobuf))
-			return PTR_ERR(iobuf);
+		if (now < 0)
+			return now;
 
-		memcpy(buf, iobuf, BLOCKSIZE(blk));
-		buf += BLOCKSIZE(blk);
-		blocks--;
-		block++;
-		count -= BLOCKSIZE(blk);
+		if (!now) {
+			void *iobuf = block_get(blk, block, stream);
+
+			if (IS_ERR(iobuf))
+				return PTR_ERR(iobuf);
+
+			memcpy(buf, iobuf, BLOCKSIZE(blk));
+			now = 1;
+		}
+
+		buf += now << blk->blockbits;
+		blocks -= now;
+		block += now;
+		count -= now << blk->blockbits;
 	}
 
 	if (count) {
-		void *iobuf = block_get(blk, block);
+		void *iobuf = block_get(blk, block, stream);
 
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
@@ -249,7 +734,7 @@ static int block_put(struct block_device *blk, const void *buf, int block)
 	if (block >= blk->num_blocks)
 		return -EINVAL;
 
-	data = block_get(blk, block);
+	data = block_get(blk, block, 0);
 	if (IS_ERR(data))
 		return PTR_ERR(data);
 
@@ -270,9 +755,11 @@ static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 	size_t icount = count;
 	int blocks, ret;
 
+	block_readahead_invalidate(blk);
+
 	if (offset & mask) {
 		size_t now = BLOCKSIZE(blk) - (offset & mask);
-		void *iobuf = block_get(blk, block);
+		void *iobuf = block_get(blk, block, 0);
 
 		now = min(count, now);
 
@@ -303,7 +790,7 @@ static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 	}
 
 	if (count) {
-		void *iobuf = block_get(blk, block);
+		void *iobuf = block_get(blk, block, 0);
 
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
@@ -346,7 +833,6 @@ int blockdevice_register(struct block_device *blk)
 {
 	loff_t size = (loff_t)blk->num_blocks * BLOCKSIZE(blk);
 	int ret;
-	int i;
 
 	blk->cdev.size = size;
 	blk->cdev.dev = blk->dev;
@@ -354,23 +840,42 @@ int blockdevice_register(struct block_device *blk)
 	blk->cdev.priv = blk;
 	blk->rdbufsize = BUFSIZE >> blk->blockbits;
 
-	INIT_LIST_HEAD(&blk->buffered_blocks);
-	INIT_LIST_HEAD(&blk->idle_blocks);
 	blk->blkmask = blk->rdbufsize - 1;
 
+	/*
+	 * Drivers may raise the request size limit. Chunks are always read
+	 * and written with a single request, so every device accepts that.
+	 */
+	blk->max_req_blocks = max(blk->max_req_blocks, blk->rdbufsize);
+
 	debug("%s: rdbufsize: %d blockbits: %d blkmask: 0x%08x\n", __func__, blk->rdbufsize, blk->blockbits,
 			blk->blkmask);
 
-	for (i = 0; i < 8; i++) {
-		struct chunk *chunk = xzalloc(sizeof(*chunk));
-		chunk->data = dma_alloc(BUFSIZE);
-		chunk->num = i;
-		list_add_tail(&chunk->list, &blk->idle_blocks);
-	}
+	ret = block_cache_init(blk, BLOCK_CACHE_DEFAULT_CHUNKS);
+	if (ret)
+		return ret;
 
 	ret = devfs_create(&blk->cdev);
-	if (ret)
+	if (ret) {
+		block_cache_free(blk->cache_sets, 1 << blk->cache_set_bits);
+		blk->cache_sets = NULL;
 		return ret;
+	}
+
+	blk->param_cache_chunks = block_add_param(blk, "cache_chunks",
+			block_cache_chunks_set, &blk->cache_chunks);
+	blk->param_cache_hits = block_add_param(blk, "cache_hits",
+			NULL, &blk->cache_hits);
+	blk->param_cache_misses = block_add_param(blk, "cache_misses",
+			NULL, &blk->cache_misses);
+	blk->param_cache_evictions = block_add_param(blk, "cache_evictions",
+			NULL, &blk->cache_evictions);
+
+	memset(blk->ra, 0, sizeof(blk->ra));
+	blk->readahead_kb = BLOCK_READAHEAD_DEFAULT_KB;
+	blk->seq_next = -1;
+	blk->param_readahead_kb = block_add_param(blk, "readahead_kb",
+			block_readahead_kb_set, &blk->readahead_kb);
 
 	list_add_tail(&blk->list, &block_device_list);
 
@@ -379,19 +884,23 @@ int blockdevice_register(struct block_device *blk)
 
 int blockdevice_unregister(struct block_device *blk)
 {
-	struct chunk *chunk, *tmp;
-
 	writebuffer_flush(blk);
 
-	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
-	}
+	if (blk->param_cache_chunks)
+		dev_remove_param(blk->param_cache_chunks);
+	if (blk->param_cache_hits)
+		dev_remove_param(blk->param_cache_hits);
+	if (blk->param_cache_misses)
+		dev_remove_param(blk->param_cache_misses);
+	if (blk->param_cache_evictions)
+		dev_remove_param(blk->param_cache_evictions);
+	if (blk->param_readahead_kb)
+		dev_remove_param(blk->param_readahead_kb);
 
-	list_for_each_entry_safe(chunk, tmp, &blk->idle_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
-	}
+	block_readahead_free(blk);
+
+	block_cache_free(blk->cache_sets, 1 << blk->cache_set_bits);
+	blk->cache_sets = NULL;
 
 	devfs_remove(&blk->cdev);
 	list_del(&blk->list);
@@ -399,6 +908,58 @@ int blockdevice_unregister(struct block_device *blk)
 	return 0;
 }
 
+/**
+ * block_submit - start an asynchronous read
+ * @blk:	The block device
+ * @req:	The request describing the blocks to read and the buffer
+ *
+ * Starts reading @req->num_blocks blocks starting at @req->block into
+ * @req->buf. The request must be passed to block_complete() before the
+ * buffer can be used. Devices which do not support asynchronous requests
+ * read the data synchronously here. Asynchronous requests bypass the
+ * cache, so data written to the device must be flushed before.
+ * @req->num_blocks must not exceed @blk->max_req_blocks.
+ *
+ * Return: 0 if the request has been started, a negative error code
+ * otherwise.
+ */
+int block_submit(struct block_device *blk, struct block_request *req)
+{
+	int ret;
+
+	req->blk = blk;
+
+	if (!blk->ops->submit) {
+		req->status = block_read_device(blk, req->buf, req->block,
+				req->num_blocks);
+		return 0;
+	}
+
+	req->status = -EINPROGRESS;
+
+	ret = blk->ops->submit(blk, req);
+	if (ret)
+		req->status = ret;
+
+	return ret;
+}
+
+/**
+ * block_complete - wait for an asynchronous read to finish
+ * @blk:	The block device
+ * @req:	The request started with block_submit()
+ *
+ * Return: 0 if the data has been read successfully, a negative error code
+ * otherwise.
+ */
+int block_complete(struct block_device *blk, struct block_request *req)
+{
+	if (req->status == -EINPROGRESS)
+		return blk->ops->complete(blk, req);
+
+	return req->status;
+}
+
 int block_read(struct block_device *blk, void *buf, int block, int num_blocks)
 {
 	int ret;
@@ -187,13 +187,25 @@ int bootm_load_devicetree(struct image_data *data, unsigned long load_address)
 
 static int bootm_open_os_uimage(struct image_data *data)
 {
+	image_header_t *hdr;
 	int ret;
 
 	data->os = uimage_open(data->os_file);
 	if (!data->os)
 		return -EINVAL;
 
-	if (data->verify) {
+	hdr = &data->os->header;
+
+	/*
+	 * The data crc of uncompressed single images is checked while
+	 * loading them to avoid reading the image twice. Compressed data
+	 * is never fed to the uncompressor before its crc is checked.
+	 */
+	if (data->verify && data->os->nb_data_entries == 1 &&
+			(hdr->ih_comp == IH_COMP_NONE ||
+			 hdr->ih_type == IH_TYPE_RAMDISK)) {
+		data->os->verify_on_load = 1;
+	} else if (data->verify) {
 		ret = uimage_verify(data->os);
 		if (ret) {
 			printf("Checking data crc failed with %s\n",
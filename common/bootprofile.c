@@ -0,0 +1,279 @@
+/*
+ * bootprofile.c - record where the time during boot is spent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <common.h>
+#include <bootprofile.h>
+#include <clock.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <libfile.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <linux/ctype.h>
+#include <linux/list.h>
+#include <linux/math64.h>
+
+struct bootprofile_event {
+	struct list_head list;
+	enum bootprofile_type type;
+	char *name;
+	uint64_t start;
+	uint64_t end;
+	int depth;
+	int result;
+	bool untimed;	/* started before a clocksource was registered */
+};
+
+static LIST_HEAD(bootprofile_events);
+static bool bootprofile_stopped;
+static int bootprofile_depth;
+
+static const char *bootprofile_type_names[] = {
+	[BOOTPROFILE_INITCALL] = "initcall",
+	[BOOTPROFILE_PROBE] = "probe",
+	[BOOTPROFILE_DEFERRED] = "deferred",
+	[BOOTPROFILE_SCRIPT] = "script",
+};
+
+/**
+ * bootprofile_start - start recording an event
+ * @type: the kind of event
+ * @fmt: printf style format for the name of the event
+ *
+ * Return: a handle to be passed to bootprofile_end(), NULL if nothing
+ * is recorded because boot has finished already.
+ */
+struct bootprofile_event *bootprofile_start(enum bootprofile_type type,
+		const char *fmt, ...)
+{
+	struct bootprofile_event *event;
+	va_list args;
+
+	if (bootprofile_stopped)
+		return NULL;
+
+	event = xzalloc(sizeof(*event));
+
+	va_start(args, fmt);
+	event->name = vasprintf(fmt, args);
+	va_end(args);
+
+	event->type = type;
+	event->depth = bootprofile_depth++;
+	list_add_tail(&event->list, &bootprofile_events);
+
+	/*
+	 * Without a clocksource the timestamps are meaningless, and the
+	 * event registering it would span dummy and real time.
+	 */
+	event->untimed = !clocksource_available();
+	if (!event->untimed)
+		event->start = get_time_ns();
+
+	return event;
+}
+
+/**
+ * bootprofile_end - finish recording an event
+ * @event: the handle returned by bootprofile_start()
+ * @result: the return value of the recorded function
+ */
+void bootprofile_end(struct bootprofile_event *event, int result)
+{
+	if (!event)
+		return;
+
+	if (!event->untimed)
+		event->end = get_time_ns();
+	event->result = result;
+	bootprofile_depth--;
+}
+
+/**
+ * bootprofile_stop - stop recording
+ *
+ * Called when barebox starts an interactive shell, so that commands
+ * run later on don't fill up memory with events.
+ */
+void bootprofile_stop(void)
+{
+	bootprofile_stopped = true;
+}
+
+static uint64_t bootprofile_base(void)
+{
+	struct bootprofile_event *event;
+
+	list_for_each_entry(event, &bootprofile_events, list)
+		if (!event->untimed)
+			return event->start;
+
+	return 0;
+}
+
+/**
+ * bootprofile_print - print the recorded events
+ * @threshold_ns: skip events which took less than this
+ *
+ * Events are listed in the order they started, nested events are
+ * indented below the event they happened in. Events which started
+ * before a clocksource was registered have no times and are only
+ * listed without a threshold.
+ */
+void bootprofile_print(uint64_t threshold_ns)
+{
+	struct bootprofile_event *event;
+	uint64_t base = bootprofile_base(), total = 0;
+
+	printf("   start[us]    time[us]  event\n");
+
+	list_for_each_entry(event, &bootprofile_events, list) {
+		uint64_t duration = event->end - event->start;
+
+		if (event->untimed) {
+			if (!threshold_ns)
+				printf("%12s %11s  %*s%s %s\n", "?", "?",
+						event->depth * 2, "",
+						bootprofile_type_names[event->type],
+						event->name);
+			continue;
+		}
+
+		/* still running, e.g. the script which started the shell */
+		if (!event->end) {
+			printf("%12llu %11s  %*s%s %s\n",
+					div_u64(event->start - base, 1000), "-",
+					event->depth * 2, "",
+					bootprofile_type_names[event->type],
+					event->name);
+			continue;
+		}
+
+		if (!event->depth)
+			total += duration;
+
+		if (duration < threshold_ns)
+			continue;
+
+		printf("%12llu %11llu  %*s%s %s",
+				div_u64(event->start - base, 1000),
+				div_u64(duration, 1000),
+				event->depth * 2, "",
+				bootprofile_type_names[event->type],
+				event->name);
+
+		if (event->result < 0)
+			printf(" (%s)", strerror(-event->result));
+		else if (event->result)
+			printf(" (exit %d)", event->result);
+
+		printf("\n");
+	}
+
+	printf("total: %llu us\n", div_u64(total, 1000));
+}
+
+/*
+ * bootgraph.pl only accepts [a-zA-Z0-9_.] in names and expects kallsyms
+ * style "name+offset/size" strings, so create one from the event name.
+ */
+static void bootprofile_export_name(char *buf, size_t size,
+		struct bootprofile_event *event)
+{
+	char *s;
+
+	snprintf(buf, size - sizeof("+0x0/0x0"), "%s_%s",
+			bootprofile_type_names[event->type], event->name);
+
+	s = strchr(buf, '+');
+	if (s)
+		*s = 0;
+
+	for (s = buf; *s; s++)
+		if (!isalnum(*s) && *s != '.')
+			*s = '_';
+
+	strcat(buf, "+0x0/0x0");
+}
+
+static int bootprofile_write(int fd, uint64_t ns, const char *fmt, ...)
+{
+	va_list args;
+	char *msg, *line;
+	u32 rem;
+	u64 sec;
+	int ret;
+
+	va_start(args, fmt);
+	msg = vasprintf(fmt, args);
+	va_end(args);
+
+	sec = div_u64_rem(ns, 1000000000, &rem);
+	line = asprintf("[%5llu.%06u] %s", sec, rem / 1000, msg);
+
+	ret = write_full(fd, line, strlen(line));
+
+	free(line);
+	free(msg);
+
+	return ret < 0 ? ret : 0;
+}
+
+/**
+ * bootprofile_export - write the recorded events to a file
+ * @filename: the file to write to
+ *
+ * The file uses the format of the Linux initcall_debug messages, so
+ * scripts/bootgraph.pl from the Linux kernel can render it as a boot
+ * chart. Events without times are left out.
+ */
+int bootprofile_export(const char *filename)
+{
+	struct bootprofile_event *event;
+	uint64_t base = bootprofile_base();
+	char name[64];
+	int fd, ret = 0;
+
+	fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC);
+	if (fd < 0)
+		return fd;
+
+	list_for_each_entry(event, &bootprofile_events, list) {
+		if (event->untimed)
+			continue;
+
+		bootprofile_export_name(name, sizeof(name), event);
+
+		ret = bootprofile_write(fd, event->start - base,
+				"calling  %s @ 1\n", name);
+		if (ret)
+			break;
+	}
+
+	list_for_each_entry(event, &bootprofile_events, list) {
+		if (!event->end)
+			continue;
+
+		bootprofile_export_name(name, sizeof(name), event);
+
+		ret = bootprofile_write(fd, event->end - base,
+				"initcall %s returned %d after %llu usecs\n",
+				name, event->result,
+				div_u64(event->end - event->start, 1000));
+		if (ret)
+			break;
+	}
+
+	close(fd);
+
+	return ret;
+}
@@ -79,6 +79,17 @@ uint64_t get_time_ns(void)
 }
 EXPORT_SYMBOL(get_time_ns);
 
+/**
+ * clocksource_available - check if a clocksource has been registered
+ *
+ * Until then get_time_ns() returns a dummy counter which does not
+ * measure time.
+ */
+bool clocksource_available(void)
+{
+	return current_clock != NULL;
+}
+
 /**
  * clocks_calc_mult_shift - calculate mult/shift factors for scaled math of clocks
  * @mult:       pointer to mult variable
@@ -21,6 +21,7 @@
 #include <command.h>
 #include <errno.h>
 #include <console_countdown.h>
+#include <driver.h>
 #include <stdio.h>
 
 int console_countdown(int timeout_s, unsigned flags, char *out_key)
@@ -48,6 +49,8 @@ int console_countdown(int timeout_s, unsigned flags, char *out_key)
 				goto out;
 			key = 0;
 		}
+		/* nothing to do but wait, detect devices meanwhile */
+		device_detect_background();
 		if (!(flags & CONSOLE_COUNTDOWN_SILENT) &&
 		    is_timeout(second, SECOND)) {
 			printf("\b\b%2d", countdown--);
@@ -126,6 +126,7 @@
 #include <binfmt.h>
 #include <init.h>
 #include <shell.h>
+#include <bootprofile.h>
 
 /*cmd_boot.c*/
 extern int do_bootd(int flag, int argc, char *argv[]);      /* do_bootd */
@@ -1886,6 +1887,7 @@ static int execute_script(const char *path, int argc, char *argv[])
 static int source_script(const char *path, int argc, char *argv[])
 {
 	struct p_context ctx;
+	struct bootprofile_event *event;
 	char *script;
 	int ret;
 
@@ -1898,9 +1900,11 @@ static int source_script(const char *path, int argc, char *argv[])
 		return 1;
 	}
 
+	event = bootprofile_start(BOOTPROFILE_SCRIPT, "%s", path);
 	ret = parse_string_outer(&ctx, script, FLAG_PARSE_SEMICOLON);
 	if (ret < -1)
 		ret = -ret - 2;
+	bootprofile_end(event, ret);
 
 	release_context(&ctx);
 	free(script);
@@ -1915,6 +1919,8 @@ int run_shell(void)
 	struct p_context ctx;
 	int exit = 0;
 
+	bootprofile_stop();
+
 	login();
 
 	do {
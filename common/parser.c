@@ -3,6 +3,7 @@
 #include <password.h>
 #include <environment.h>
 #include <shell.h>
+#include <bootprofile.h>
 
 /*
  * not yet supported
@@ -267,6 +268,8 @@ int run_shell(void)
 	int len;
 	int rc = 1;
 
+	bootprofile_stop();
+
 	login();
 
 	for (;;) {
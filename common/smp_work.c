@@ -0,0 +1,208 @@
+/*
+ * smp_work.c - run computation jobs on secondary CPUs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * barebox runs on the boot CPU only. Secondary CPUs the architecture
+ * brought up sit in a loop calling smp_work_secondary(), each with a
+ * single slot the boot CPU puts a job into. As only the boot CPU queues
+ * jobs and only the secondary clears its slot, no locking is needed,
+ * just memory barriers. Memory has to be coherent between the CPUs.
+ * Currently only sandbox provides secondary CPUs, as host threads.
+ */
+#include <common.h>
+#include <smp_work.h>
+#include <linux/sizes.h>
+
+#define SMP_WORK_MAX_CPUS	8
+
+static LIST_HEAD(smp_work_cpus);
+static int smp_work_cpus_nr;
+
+/**
+ * smp_work_add_cpu - make a secondary CPU available for jobs
+ * @cpu: the CPU, its id and kick callback filled in
+ *
+ * Called by the architecture on the boot CPU. Once added, the secondary
+ * must call smp_work_secondary() until it returns 0 whenever it has been
+ * kicked.
+ */
+void smp_work_add_cpu(struct smp_work_cpu *cpu)
+{
+	if (smp_work_cpus_nr == SMP_WORK_MAX_CPUS)
+		return;
+
+	cpu->work = NULL;
+	list_add_tail(&cpu->list, &smp_work_cpus);
+	smp_work_cpus_nr++;
+
+	pr_debug("smp_work: added cpu%d\n", cpu->id);
+}
+
+/**
+ * smp_work_secondary - run the pending job of a secondary CPU
+ * @cpu: the CPU we are running on
+ *
+ * Return: 1 if a job has been run, 0 if there was none
+ */
+int smp_work_secondary(struct smp_work_cpu *cpu)
+{
+	struct smp_work *work = cpu->work;
+
+	if (!work)
+		return 0;
+
+	smp_work_mb();
+
+	work->fn(work);
+
+	smp_work_mb();
+	work->done = 1;
+	cpu->work = NULL;
+
+	return 1;
+}
+
+/**
+ * smp_work_nr_cpus - number of secondary CPUs available for jobs
+ */
+int smp_work_nr_cpus(void)
+{
+	return smp_work_cpus_nr;
+}
+
+/**
+ * smp_work_queue - run a job on an idle secondary CPU
+ * @work: the job, its fn filled in
+ *
+ * If all secondaries are busy, the job is run right away on the boot
+ * CPU. Either way smp_work_wait() must be called before the results of
+ * the job are used or @work goes out of scope.
+ *
+ * Return: the id of the CPU the job runs on, 0 for the boot CPU
+ */
+int smp_work_queue(struct smp_work *work)
+{
+	struct smp_work_cpu *cpu;
+
+	work->done = 0;
+
+	list_for_each_entry(cpu, &smp_work_cpus, list) {
+		if (cpu->work)
+			continue;
+
+		smp_work_mb();
+		cpu->work = work;
+		if (cpu->kick)
+			cpu->kick(cpu);
+
+		return cpu->id;
+	}
+
+	work->fn(work);
+	work->done = 1;
+
+	return 0;
+}
+
+/**
+ * smp_work_wait - wait for a job to finish
+ * @work: the job passed to smp_work_queue()
+ */
+void smp_work_wait(struct smp_work *work)
+{
+	while (!work->done)
+		barrier();
+
+	smp_work_mb();
+}
+
+struct smp_work_range {
+	struct smp_work work;
+	void (*fn)(void *ctx, size_t start, size_t len);
+	void *ctx;
+	size_t start;
+	size_t len;
+};
+
+static void smp_work_range_fn(struct smp_work *work)
+{
+	struct smp_work_range *r = container_of(work, struct smp_work_range,
+			work);
+
+	r->fn(r->ctx, r->start, r->len);
+}
+
+/**
+ * smp_work_range - split a computation over all CPUs
+ * @fn: called with @ctx for each part of the range
+ * @ctx: context for @fn
+ * @len: length of the whole range
+ * @align: alignment of the parts, must be a power of two
+ *
+ * The range 0..@len is split into one part for each secondary and one
+ * for the boot CPU. Returns once all parts have been processed.
+ */
+void smp_work_range(void (*fn)(void *ctx, size_t start, size_t len),
+		void *ctx, size_t len, size_t align)
+{
+	struct smp_work_range r[SMP_WORK_MAX_CPUS];
+	size_t part, start = 0;
+	int i, n = smp_work_cpus_nr;
+
+	part = ALIGN(DIV_ROUND_UP(len, n + 1), align);
+
+	for (i = 0; i < n && len - start > part; i++) {
+		r[i].work.fn = smp_work_range_fn;
+		r[i].fn = fn;
+		r[i].ctx = ctx;
+		r[i].start = start;
+		r[i].len = part;
+		smp_work_queue(&r[i].work);
+		start += part;
+	}
+
+	fn(ctx, start, len - start);
+
+	while (i--)
+		smp_work_wait(&r[i].work);
+}
+
+struct smp_memset {
+	void *s;
+	int c;
+};
+
+static void smp_memset_fn(void *ctx, size_t start, size_t len)
+{
+	struct smp_memset *m = ctx;
+
+	memset(m->s + start, m->c, len);
+}
+
+/**
+ * smp_memset - memset() for large areas, using all CPUs
+ */
+void smp_memset(void *s, int c, size_t n)
+{
+	struct smp_memset m = {
+		.s = s,
+		.c = c,
+	};
+
+	if (n < SZ_1M || !smp_work_cpus_nr) {
+		memset(s, c, n);
+		return;
+	}
+
+	smp_work_range(smp_memset_fn, &m, n, SZ_4K);
+}
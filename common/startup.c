@@ -41,6 +41,7 @@
 #include <asm/sections.h>
 #include <uncompress.h>
 #include <globalvar.h>
+#include <bootprofile.h>
 
 extern initcall_t __barebox_initcalls_start[], __barebox_early_initcalls_end[],
 		  __barebox_initcalls_end[];
@@ -96,8 +97,13 @@ void __noreturn start_barebox(void)
 
 	for (initcall = __barebox_initcalls_start;
 			initcall < __barebox_initcalls_end; initcall++) {
+		struct bootprofile_event *event;
+
 		pr_debug("initcall-> %pS\n", *initcall);
+		event = bootprofile_start(BOOTPROFILE_INITCALL, "%pS",
+				*initcall);
 		result = (*initcall)();
+		bootprofile_end(event, result);
 		if (result)
 			pr_err("initcall %pS failed: %s\n", *initcall,
 					strerror(-result));
@@ -225,10 +225,92 @@ void uimage_close(struct uimage_handle *handle)
 EXPORT_SYMBOL(uimage_close);
 
 static int uimage_fd;
+static size_t uimage_left;
+static int uimage_dcrc_active;
+static u32 uimage_dcrc;
 
+/*
+ * Read the next part of the image currently being loaded. Never reads
+ * beyond the end of the image and updates the data crc on the fly when
+ * it is checked while loading.
+ */
 static int uimage_fill(void *buf, unsigned int len)
 {
-	return read_full(uimage_fd, buf, len);
+	int ret;
+
+	len = min_t(size_t, len, uimage_left);
+
+	ret = read_full(uimage_fd, buf, len);
+	if (ret <= 0)
+		return ret;
+
+	if (uimage_dcrc_active)
+		uimage_dcrc = crc32(uimage_dcrc, buf, ret);
+
+	uimage_left -= ret;
+
+	return ret;
+}
+
+static int uimage_stream_start(struct uimage_handle *handle,
+		unsigned int image_no)
+{
+	struct uimage_handle_data *iha = &handle->ihd[image_no];
+	int ret;
+
+	ret = lseek(handle->fd, iha->offset + handle->data_offset,
+			SEEK_SET);
+	if (ret < 0)
+		return ret;
+
+	uimage_fd = handle->fd;
+	uimage_left = iha->len;
+	uimage_dcrc = 0;
+	uimage_dcrc_active = handle->verify_on_load &&
+		!uimage_is_multi_image(handle);
+
+	return 0;
+}
+
+/*
+ * Finish loading an image. When the data crc is checked while loading
+ * this consumes the data the uncompressor did not need (i.e. padding)
+ * and compares the crc.
+ */
+static int uimage_stream_finish(struct uimage_handle *handle)
+{
+	void *buf;
+	int ret = 0;
+
+	if (!uimage_dcrc_active)
+		return 0;
+
+	uimage_dcrc_active = 0;
+
+	buf = xmalloc(PAGE_SIZE);
+
+	while (uimage_left) {
+		uimage_dcrc_active = 1;
+		ret = uimage_fill(buf, PAGE_SIZE);
+		uimage_dcrc_active = 0;
+		if (ret <= 0) {
+			ret = ret ? ret : -EIO;
+			goto out;
+		}
+	}
+
+	if (uimage_dcrc != handle->header.ih_dcrc) {
+		printf("Bad Data CRC: 0x%08x != 0x%08x\n",
+				uimage_dcrc, handle->header.ih_dcrc);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = 0;
+out:
+	free(buf);
+
+	return ret;
 }
 
 static int uncompress_copy(unsigned char *inbuf_unused, int len,
@@ -319,9 +401,8 @@ int uimage_load(struct uimage_handle *handle, unsigned int image_no,
 
 	iha = &handle->ihd[image_no];
 
-	ret = lseek(handle->fd, iha->offset + handle->data_offset,
-			SEEK_SET);
-	if (ret < 0)
+	ret = uimage_stream_start(handle, image_no);
+	if (ret)
 		return ret;
 
 	/* if ramdisk U-Boot expect to ignore the compression type */
@@ -330,12 +411,13 @@ int uimage_load(struct uimage_handle *handle, unsigned int image_no,
 	else
 		uncompress_fn = uncompress;
 
-	uimage_fd = handle->fd;
-
 	ret = uncompress_fn(NULL, iha->len, uimage_fill, flush,
 				NULL, NULL,
 				uncompress_err_stdout);
-	return ret;
+	if (ret)
+		return ret;
+
+	return uimage_stream_finish(handle);
 }
 EXPORT_SYMBOL(uimage_load);
 
@@ -377,12 +459,35 @@ struct resource *file_to_sdram(const char *filename, unsigned long adr)
 	size_t size = BUFSIZ;
 	size_t ofs = 0;
 	ssize_t now;
+	struct stat s;
 	int fd;
 
 	fd = open(filename, O_RDONLY);
 	if (fd < 0)
 		return NULL;
 
+	/*
+	 * When the size is known read the whole file with a single read
+	 * which allows the underlying device to transfer the data directly
+	 * to its final location.
+	 */
+	if (!fstat(fd, &s) && s.st_size && s.st_size != FILE_SIZE_STREAM) {
+		res = request_sdram_region("image", adr, s.st_size);
+		if (!res) {
+			printf("unable to request SDRAM 0x%08lx-0x%08lx\n",
+				adr, adr + (unsigned long)s.st_size - 1);
+			goto out;
+		}
+
+		now = read_full(fd, (void *)res->start, s.st_size);
+		if (now < s.st_size) {
+			release_sdram_region(res);
+			res = NULL;
+		}
+
+		goto out;
+	}
+
 	while (1) {
 		res = request_sdram_region("image", adr, size);
 		if (!res) {
@@ -415,16 +520,52 @@ out:
 	return res;
 }
 
+/*
+ * Get the uncompressed size of a gzip compressed image from the gzip
+ * trailer. Returns 0 if it cannot be determined. The trailer is not
+ * covered by anything checked before uncompressing, so the result may
+ * only be used as a hint.
+ */
+static size_t uimage_gzip_size(struct uimage_handle *handle, int image_no)
+{
+	struct uimage_handle_data *iha = &handle->ihd[image_no];
+	u32 size;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_ZLIB) || handle->header.ih_comp != IH_COMP_GZIP ||
+			handle->header.ih_type == IH_TYPE_RAMDISK || iha->len < 18)
+		return 0;
+
+	ret = lseek(handle->fd, iha->offset + handle->data_offset +
+			iha->len - 4, SEEK_SET);
+	if (ret < 0)
+		return 0;
+
+	ret = read_full(handle->fd, &size, 4);
+	if (ret < 4)
+		return 0;
+
+	return le32_to_cpu(size);
+}
+
 /*
  * Load an uImage to a dynamically allocated sdram resource.
  * the resource must be freed afterwards with release_sdram_region
+ *
+ * Uncompressed images are read directly to their final location.
+ * Compressed images go through the flush callback which checks every
+ * write against the region and grows it when necessary. For gzip
+ * compressed images the region is initially sized from the gzip trailer
+ * so that it usually does not have to be grown.
  */
 struct resource *uimage_load_to_sdram(struct uimage_handle *handle,
 		int image_no, unsigned long load_address)
 {
 	int ret;
 	ssize_t size;
+	size_t gzsize;
 	resource_size_t start = (resource_size_t)load_address;
+	image_header_t *hdr = &handle->header;
 
 	uimage_buf = (void *)load_address;
 	uimage_size = 0;
@@ -433,7 +574,15 @@ struct resource *uimage_load_to_sdram(struct uimage_handle *handle,
 	if (size < 0)
 		return NULL;
 
-	uimage_resource = request_sdram_region("uimage",
+	gzsize = uimage_gzip_size(handle, image_no);
+	if (gzsize)
+		uimage_resource = request_sdram_region("uimage",
+				start, gzsize);
+	else
+		uimage_resource = NULL;
+
+	if (!uimage_resource)
+		uimage_resource = request_sdram_region("uimage",
 				start, size);
 	if (!uimage_resource) {
 		printf("unable to request SDRAM 0x%08llx-0x%08llx\n",
@@ -442,7 +591,18 @@ struct resource *uimage_load_to_sdram(struct uimage_handle *handle,
 		return NULL;
 	}
 
-	ret = uimage_load(handle, image_no, uimage_sdram_flush);
+	if (hdr->ih_comp == IH_COMP_NONE || hdr->ih_type == IH_TYPE_RAMDISK) {
+		ret = uimage_stream_start(handle, image_no);
+		if (!ret) {
+			ret = uimage_fill(uimage_buf, size);
+			ret = ret == size ? 0 : -EIO;
+		}
+		if (!ret)
+			ret = uimage_stream_finish(handle);
+	} else {
+		ret = uimage_load(handle, image_no, uimage_sdram_flush);
+	}
+
 	if (ret) {
 		release_sdram_region(uimage_resource);
 		return NULL;
@@ -133,29 +133,94 @@ static const ulong crc_table[256] = {
 
 /* ========================================================================= */
 #define DO1(buf) crc = crc_table[((int)crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
-#define DO2(buf)  DO1(buf); DO1(buf);
-#define DO4(buf)  DO2(buf); DO2(buf);
-#define DO8(buf)  DO4(buf); DO4(buf);
 
-/* ========================================================================= */
-uint32_t crc32(uint32_t crc, const void *_buf, unsigned int len)
+#define LE32(p) ((uint32_t)(p)[0] | (uint32_t)(p)[1] << 8 | \
+		 (uint32_t)(p)[2] << 16 | (uint32_t)(p)[3] << 24)
+
+/*
+ * Tables for the slice-by-8 algorithm: crc_table8[k][n] is the CRC of
+ * the byte n followed by k + 1 zero bytes. They are derived from
+ * crc_table on first use.
+ */
+static uint32_t crc_table8[7][256];
+static int crc_table8_empty = 1;
+
+static void make_crc_table8(void)
 {
-    const unsigned char *buf = _buf;
+	uint32_t c;
+	int n, k;
 
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
-    if (crc_table_empty)
-      make_crc_table();
+	if (crc_table_empty)
+		make_crc_table();
+#endif
+	for (n = 0; n < 256; n++) {
+		c = crc_table[n];
+		for (k = 0; k < 7; k++) {
+			c = crc_table[c & 0xff] ^ (c >> 8);
+			crc_table8[k][n] = c;
+		}
+	}
+
+	crc_table8_empty = 0;
+}
+
+#ifdef __BAREBOX__
+/*
+ * Optional architecture specific implementation, only called for lengths
+ * which are a multiple of 16 and at least CRC32_ACCEL_MIN_LEN.
+ */
+static uint32_t (*crc32_accel)(uint32_t crc, const void *buf, unsigned int len);
+
+#define CRC32_ACCEL_MIN_LEN	64
 #endif
-    crc = crc ^ 0xffffffffL;
-    while (len >= 8)
-    {
-      DO8(buf);
-      len -= 8;
-    }
-    if (len) do {
-      DO1(buf);
-    } while (--len);
-    return crc ^ 0xffffffffL;
+
+/* CRC-32 without pre and post conditioning, eight bytes at a time */
+static uint32_t crc32_le(uint32_t crc, const unsigned char *buf,
+		unsigned int len)
+{
+	uint32_t a, b;
+
+	if (crc_table8_empty)
+		make_crc_table8();
+
+#ifdef __BAREBOX__
+	if (crc32_accel && len >= CRC32_ACCEL_MIN_LEN) {
+		unsigned int now = len & ~15;
+
+		crc = crc32_accel(crc, buf, now);
+		buf += now;
+		len -= now;
+	}
+#endif
+
+	while (len >= 8) {
+		a = LE32(buf) ^ crc;
+		b = LE32(buf + 4);
+
+		crc = crc_table8[6][a & 0xff] ^
+		      crc_table8[5][(a >> 8) & 0xff] ^
+		      crc_table8[4][(a >> 16) & 0xff] ^
+		      crc_table8[3][a >> 24] ^
+		      crc_table8[2][b & 0xff] ^
+		      crc_table8[1][(b >> 8) & 0xff] ^
+		      crc_table8[0][(b >> 16) & 0xff] ^
+		      crc_table[b >> 24];
+
+		buf += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		DO1(buf);
+
+	return crc;
+}
+
+/* ========================================================================= */
+uint32_t crc32(uint32_t crc, const void *_buf, unsigned int len)
+{
+    return crc32_le(crc ^ 0xffffffffL, _buf, len) ^ 0xffffffffL;
 }
 #ifdef __BAREBOX__
 EXPORT_SYMBOL(crc32);
@@ -166,24 +231,68 @@ EXPORT_SYMBOL(crc32);
  */
 uint32_t crc32_no_comp(uint32_t crc, const void *_buf, unsigned int len)
 {
-   const unsigned char *buf = _buf;
+    return crc32_le(crc, _buf, len);
+}
 
-#ifdef CONFIG_DYNAMIC_CRC_TABLE
-    if (crc_table_empty)
-      make_crc_table();
-#endif
-    while (len >= 8)
-    {
-      DO8(buf);
-      len -= 8;
-    }
-    if (len) do {
-      DO1(buf);
-    } while (--len);
-
-    return crc;
+#ifdef __BAREBOX__
+#define CRC32_KAT_BUF_SIZE	1024
+
+static int crc32_kat(void)
+{
+	unsigned char *buf;
+	int i, ret = 0;
+
+	if (crc32(0, "123456789", 9) != 0xcbf43926)
+		return -EINVAL;
+
+	buf = xmalloc(CRC32_KAT_BUF_SIZE);
+
+	for (i = 0; i < CRC32_KAT_BUF_SIZE; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	if (crc32(0, buf, CRC32_KAT_BUF_SIZE) != 0x463b8ee9 ||
+	    crc32(0, buf + 3, 1000) != 0x53aebc93)
+		ret = -EINVAL;
+
+	free(buf);
+
+	return ret;
 }
 
+/*
+ * Register an architecture specific CRC-32 implementation. @fn computes
+ * the CRC without pre and post conditioning like crc32_no_comp() and is
+ * only called for lengths which are a multiple of 16 and at least 64.
+ * The implementation is checked with a known-answer test and is only
+ * used when it passes.
+ */
+int crc32_register_accel(uint32_t (*fn)(uint32_t crc, const void *buf,
+		unsigned int len))
+{
+	int ret;
+
+	crc32_accel = NULL;
+
+	ret = crc32_kat();
+	if (ret) {
+		pr_err("crc32: known-answer test of generic version failed\n");
+		return ret;
+	}
+
+	crc32_accel = fn;
+
+	ret = crc32_kat();
+	if (ret) {
+		crc32_accel = NULL;
+		pr_err("crc32: known-answer test of accelerated version failed\n");
+		return ret;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(crc32_register_accel);
+#endif
+
 int file_crc(char *filename, ulong start, ulong size, ulong *crc,
 		    ulong *total)
 {
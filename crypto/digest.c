@@ -22,10 +22,17 @@
 #include <fs.h>
 #include <fcntl.h>
 #include <linux/stat.h>
+#include <libfile.h>
 #include <errno.h>
 #include <module.h>
 #include <linux/err.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+#include <clock.h>
+#include <init.h>
+#include <crypto/sha.h>
 #include <crypto/internal.h>
+#include <smp_work.h>
 
 static LIST_HEAD(digests);
 
@@ -139,14 +146,9 @@ void digest_algo_prints(const char *prefix)
 	}
 }
 
-struct digest *digest_alloc(const char *name)
+static struct digest *digest_alloc_algo(struct digest_algo *algo)
 {
 	struct digest *d;
-	struct digest_algo *algo;
-
-	algo = digest_algo_get_by_name(name);
-	if (!algo)
-		return NULL;
 
 	d = xzalloc(sizeof(*d));
 	d->algo = algo;
@@ -158,6 +160,17 @@ struct digest *digest_alloc(const char *name)
 
 	return d;
 }
+
+struct digest *digest_alloc(const char *name)
+{
+	struct digest_algo *algo;
+
+	algo = digest_algo_get_by_name(name);
+	if (!algo)
+		return NULL;
+
+	return digest_alloc_algo(algo);
+}
 EXPORT_SYMBOL_GPL(digest_alloc);
 
 void digest_free(struct digest *d)
@@ -170,6 +183,33 @@ void digest_free(struct digest *d)
 }
 EXPORT_SYMBOL_GPL(digest_free);
 
+/*
+ * Buffer size used to read files which can't be memmapped. This is kept
+ * below the block layer chunk size so that sequential reads are served
+ * from its read-ahead windows whose successors are fetched asynchronously
+ * while the current buffer is hashed.
+ */
+#define DIGEST_BUF_SIZE		(PAGE_SIZE * 8)
+
+struct digest_work {
+	struct smp_work work;
+	struct digest *d;
+	const unsigned char *buf;
+	int len;
+	int ret;
+};
+
+static void digest_work_fn(struct smp_work *work)
+{
+	struct digest_work *dw = container_of(work, struct digest_work, work);
+
+	dw->ret = digest_update(dw->d, dw->buf, dw->len);
+}
+
+/*
+ * The digest of a chunk is updated as a job on a secondary CPU (if any)
+ * while the next chunk is read into the other half of the buffer.
+ */
 int digest_file_window(struct digest *d, const char *filename,
 		       unsigned char *hash,
 		       const unsigned char *sig,
@@ -177,8 +217,13 @@ int digest_file_window(struct digest *d, const char *filename,
 {
 	ulong len = 0;
 	int fd, now, ret = 0;
-	unsigned char *buf;
+	unsigned char *buf, *cur;
 	int flags = 0;
+	struct digest_work dw = {
+		.work.fn = digest_work_fn,
+		.work.done = 1,
+		.d = d,
+	};
 
 	ret = digest_init(d);
 	if (ret)
@@ -192,7 +237,7 @@ int digest_file_window(struct digest *d, const char *filename,
 
 	buf = memmap(fd, PROT_READ);
 	if (buf == (void *)-1) {
-		buf = xmalloc(4096);
+		buf = xmalloc(DIGEST_BUF_SIZE * 2);
 		flags = 1;
 	}
 
@@ -208,10 +253,12 @@ int digest_file_window(struct digest *d, const char *filename,
 		}
 	}
 
+	cur = buf;
+
 	while (size) {
-		now = min((ulong)4096, size);
+		now = min((ulong)DIGEST_BUF_SIZE, size);
 		if (flags) {
-			now = read(fd, buf, now);
+			now = read_full(fd, cur, now);
 			if (now < 0) {
 				ret = now;
 				perror("read");
@@ -226,19 +273,37 @@ int digest_file_window(struct digest *d, const char *filename,
 			goto out_free;
 		}
 
-		ret = digest_update(d, buf, now);
+		smp_work_wait(&dw.work);
+		ret = dw.ret;
 		if (ret)
 			goto out_free;
+
+		dw.buf = cur;
+		dw.len = now;
+		smp_work_queue(&dw.work);
+
 		size -= now;
 		len += now;
+		if (!flags)
+			cur += now;
+		else if (cur == buf)
+			cur = buf + DIGEST_BUF_SIZE;
+		else
+			cur = buf;
 	}
 
+	smp_work_wait(&dw.work);
+	ret = dw.ret;
+	if (ret)
+		goto out_free;
+
 	if (sig)
 		ret = digest_verify(d, sig);
 	else
 		ret = digest_final(d, hash);
 
 out_free:
+	smp_work_wait(&dw.work);
 	if (flags)
 		free(buf);
 out:
@@ -280,3 +345,229 @@ int digest_file_by_name(const char *algo, const char *filename,
 	return ret;
 }
 EXPORT_SYMBOL_GPL(digest_file_by_name);
+
+#ifdef CONFIG_DIGEST_SELFTEST
+
+#define DIGEST_SELFTEST_MAX_LEN	4097
+
+static const unsigned int digest_selftest_len[] = {
+	0, 3, 55, 56, 63, 64, 65, 127, 1000, DIGEST_SELFTEST_MAX_LEN,
+};
+
+static int digest_selftest_hash(struct digest_algo *algo, const u8 *buf,
+		unsigned int len, unsigned int split, u8 *hash)
+{
+	struct digest *d;
+	int ret;
+
+	d = digest_alloc_algo(algo);
+	if (!d)
+		return -ENOMEM;
+
+	if (digest_is_flags(d, DIGEST_ALGO_NEED_KEY)) {
+		ret = digest_set_key(d, buf, 20);
+		if (ret)
+			goto out;
+	}
+
+	ret = digest_init(d);
+	if (ret)
+		goto out;
+
+	ret = digest_update(d, buf, split);
+	if (ret)
+		goto out;
+
+	ret = digest_update(d, buf + split, len - split);
+	if (ret)
+		goto out;
+
+	ret = digest_final(d, hash);
+	if (ret)
+		goto out;
+
+	ret = digest_length(d);
+out:
+	digest_free(d);
+
+	return ret;
+}
+
+/*
+ * Check @algo against @ref. The data is passed to @algo in two unevenly
+ * sized updates to exercise its handling of partial blocks.
+ */
+static int digest_selftest_one(struct digest_algo *algo,
+		struct digest_algo *ref, const u8 *buf)
+{
+	u8 hash[SHA512_DIGEST_SIZE], expect[SHA512_DIGEST_SIZE];
+	unsigned int len;
+	int i, ret, length;
+
+	for (i = 0; i < ARRAY_SIZE(digest_selftest_len); i++) {
+		len = digest_selftest_len[i];
+
+		length = digest_selftest_hash(ref, buf, len, len, expect);
+		if (length < 0)
+			return length;
+
+		ret = digest_selftest_hash(algo, buf, len, len / 3, hash);
+		if (ret < 0)
+			return ret;
+
+		if (ret != length || memcmp(hash, expect, length))
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* The lowest priority implementation of an algorithm serves as reference */
+static struct digest_algo *digest_algo_get_reference(struct digest_algo *algo)
+{
+	struct digest_algo *ref = NULL;
+	struct digest_algo *tmp;
+
+	list_for_each_entry(tmp, &digests, list) {
+		if (tmp == algo || strcmp(tmp->base.name, algo->base.name))
+			continue;
+
+		if (ref && tmp->base.priority >= ref->base.priority)
+			continue;
+
+		ref = tmp;
+	}
+
+	if (ref && ref->base.priority >= algo->base.priority)
+		return NULL;
+
+	return ref;
+}
+
+static int digest_selftest(void)
+{
+	struct digest_algo *algo, *tmp, *ref;
+	u8 *buf;
+	int i, ret;
+
+	buf = xmalloc(DIGEST_SELFTEST_MAX_LEN);
+
+	for (i = 0; i < DIGEST_SELFTEST_MAX_LEN; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	list_for_each_entry_safe(algo, tmp, &digests, list) {
+		ref = digest_algo_get_reference(algo);
+		if (!ref)
+			continue;
+
+		ret = digest_selftest_one(algo, ref, buf);
+		if (!ret)
+			continue;
+
+		pr_err("%s: self test failed, using %s instead\n",
+			algo->base.driver_name, ref->base.driver_name);
+		digest_algo_unregister(algo);
+	}
+
+	free(buf);
+
+	return 0;
+}
+late_initcall(digest_selftest);
+
+#endif
+
+#define DIGEST_BENCH_BUF_SIZE	SZ_64K
+
+static int digest_benchmark_one(struct digest_algo *algo, void *buf,
+		uint64_t duration)
+{
+	struct digest *d;
+	unsigned char *hash;
+	uint64_t start, ns, total = 0, rate;
+	int ret;
+
+	d = digest_alloc_algo(algo);
+	if (!d)
+		return -ENOMEM;
+
+	hash = xzalloc(digest_length(d));
+
+	if (digest_is_flags(d, DIGEST_ALGO_NEED_KEY)) {
+		ret = digest_set_key(d, buf, 16);
+		if (ret)
+			goto out;
+	}
+
+	ret = digest_init(d);
+	if (ret)
+		goto out;
+
+	start = get_time_ns();
+
+	do {
+		ret = digest_update(d, buf, DIGEST_BENCH_BUF_SIZE);
+		if (ret)
+			goto out;
+		total += DIGEST_BENCH_BUF_SIZE;
+	} while (!is_timeout(start, duration));
+
+	ret = digest_final(d, hash);
+	if (ret)
+		goto out;
+
+	ns = get_time_ns() - start;
+
+	/* MB/s with two decimal places */
+	rate = div64_u64(total * 100000, ns);
+
+	printf("%-15s\t%-20s\t%6llu.%02llu MB/s\n", algo->base.name,
+		algo->base.driver_name, rate / 100, rate % 100);
+
+	if (ctrlc())
+		ret = -EINTR;
+out:
+	free(hash);
+	digest_free(d);
+
+	return ret;
+}
+
+/*
+ * Measure the throughput of all registered implementations of the
+ * algorithm @name, or of all algorithms if @name is NULL. Every
+ * implementation is run for @duration ns.
+ */
+int digest_algo_benchmark(const char *name, uint64_t duration)
+{
+	struct digest_algo *algo;
+	void *buf;
+	int i, ret = 0, found = 0;
+
+	buf = xmalloc(DIGEST_BENCH_BUF_SIZE);
+
+	for (i = 0; i < DIGEST_BENCH_BUF_SIZE; i++)
+		((u8 *)buf)[i] = i;
+
+	list_for_each_entry(algo, &digests, list) {
+		if (name && strcmp(algo->base.name, name))
+			continue;
+
+		found = 1;
+
+		ret = digest_benchmark_one(algo, buf, duration);
+		if (ret == -EINTR)
+			break;
+		if (ret)
+			printf("%-15s\t%-20s\tfailed: %s\n", algo->base.name,
+				algo->base.driver_name, strerror(-ret));
+	}
+
+	free(buf);
+
+	if (!found)
+		return -ENOENT;
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(digest_algo_benchmark);
@@ -36,6 +36,7 @@
 #include <linux/err.h>
 #include <complete.h>
 #include <pinctrl.h>
+#include <bootprofile.h>
 
 LIST_HEAD(device_list);
 EXPORT_SYMBOL(device_list);
@@ -83,13 +84,17 @@ int get_free_deviceid(const char *name_template)
 
 int device_probe(struct device_d *dev)
 {
+	struct bootprofile_event *event;
 	int ret;
 
 	pinctrl_select_state_default(dev);
 
 	list_add(&dev->active, &active);
 
+	event = bootprofile_start(BOOTPROFILE_PROBE, "%s (%s)", dev_name(dev),
+			dev->driver->name);
 	ret = dev->bus->probe(dev);
+	bootprofile_end(event, ret);
 	if (ret == 0)
 		return 0;
 
@@ -108,9 +113,23 @@ int device_probe(struct device_d *dev)
 
 int device_detect(struct device_d *dev)
 {
+	int ret;
+
 	if (!dev->detect)
 		return -ENOSYS;
-	return dev->detect(dev);
+
+	/*
+	 * A detect() looking up one of the cdevs it is about to create
+	 * would end up here again through cdev_by_name_detect().
+	 */
+	if (dev->detecting)
+		return -EBUSY;
+
+	dev->detecting = 1;
+	ret = dev->detect(dev);
+	dev->detecting = 0;
+
+	return ret;
 }
 
 int device_detect_by_name(const char *__devname)
@@ -159,9 +178,52 @@ err_out:
 	return -1;
 }
 
+/*
+ * Devicetree devices on busses using device_match() can only match a
+ * driver with an of_compatible table if the table lists one of the
+ * compatibles of the device. For these pairs the compatible index tells
+ * which drivers a device and which devices a driver has to be tried
+ * against, all other pairs are skipped.
+ */
+static unsigned int match_tried, match_avoided;
+
+static bool match_by_index(struct device_d *dev, struct driver_d *drv)
+{
+	return IS_ENABLED(CONFIG_OFDEVICE) && dev->bus->match == device_match &&
+		drv->of_compatible && dev->device_node &&
+		dev->of_compat_node == dev->device_node;
+}
+
+static bool driver_in_list(struct driver_d **list, struct driver_d *drv)
+{
+	while (list && *list)
+		if (*list++ == drv)
+			return true;
+
+	return false;
+}
+
+static bool device_in_list(struct device_d **list, struct device_d *dev)
+{
+	while (list && *list)
+		if (*list++ == dev)
+			return true;
+
+	return false;
+}
+
+static int match_report(void)
+{
+	pr_debug("driver matching: %u attempts, %u avoided by the compatible index\n",
+			match_tried, match_avoided);
+
+	return 0;
+}
+late_initcall(match_report);
+
 int register_device(struct device_d *new_device)
 {
-	struct driver_d *drv;
+	struct driver_d *drv, **drvs = NULL;
 
 	if (new_device->id == DEVICE_ID_DYNAMIC) {
 		new_device->id = get_free_deviceid(new_device->name);
@@ -188,10 +250,24 @@ int register_device(struct device_d *new_device)
 
 		list_add_tail(&new_device->bus_list, &new_device->bus->device_list);
 
+		if (IS_ENABLED(CONFIG_OFDEVICE) && new_device->device_node) {
+			of_device_index_add(new_device);
+			drvs = of_driver_index_lookup(new_device->device_node);
+		}
+
 		bus_for_each_driver(new_device->bus, drv) {
+			if (match_by_index(new_device, drv) &&
+					!driver_in_list(drvs, drv)) {
+				match_avoided++;
+				continue;
+			}
+
+			match_tried++;
 			if (!match(drv, new_device))
 				break;
 		}
+
+		free(drvs);
 	}
 
 	if (new_device->parent)
@@ -225,6 +301,9 @@ int unregister_device(struct device_d *old_dev)
 		}
 	}
 
+	if (IS_ENABLED(CONFIG_OFDEVICE))
+		of_device_index_remove(old_dev);
+
 	list_del(&old_dev->list);
 	list_del(&old_dev->bus_list);
 	list_del(&old_dev->active);
@@ -248,7 +327,9 @@ static int device_probe_deferred(void)
 {
 	struct device_d *dev, *tmp;
 	struct driver_d *drv;
+	struct bootprofile_event *event;
 	bool success;
+	int pass = 0;
 
 	do {
 		success = false;
@@ -256,6 +337,9 @@ static int device_probe_deferred(void)
 		if (list_empty(&deferred))
 			break;
 
+		event = bootprofile_start(BOOTPROFILE_DEFERRED, "pass %d",
+				++pass);
+
 		list_for_each_entry_safe(dev, tmp, &deferred, active) {
 			list_del(&dev->active);
 			dev_dbg(dev, "re-probe device\n");
@@ -266,6 +350,8 @@ static int device_probe_deferred(void)
 				break;
 			}
 		}
+
+		bootprofile_end(event, 0);
 	} while (success);
 
 	if (list_empty(&deferred))
@@ -278,6 +364,45 @@ static int device_probe_deferred(void)
 }
 late_initcall(device_probe_deferred);
 
+#ifdef CONFIG_DEVICE_DETECT_BACKGROUND
+static int detect_background_next;
+
+/**
+ * device_detect_background - detect the next not yet detected device
+ *
+ * Called repeatedly while barebox is idle, i.e. during the autoboot
+ * countdown, so that slow devices like MMC cards or USB busses are
+ * scanned while barebox is waiting anyway. Each call detects at most one
+ * device. Devices are counted instead of remembered, as they may be
+ * unregistered in between. Detecting a device twice does no harm.
+ */
+void device_detect_background(void)
+{
+	struct device_d *dev;
+	int i = 0;
+
+	if (detect_background_next < 0)
+		return;
+
+	for_each_device(dev) {
+		if (i++ < detect_background_next)
+			continue;
+
+		detect_background_next++;
+
+		if (!dev->detect)
+			continue;
+
+		dev_dbg(dev, "detect in background\n");
+		device_detect(dev);
+
+		return;
+	}
+
+	detect_background_next = -1;
+}
+#endif
+
 struct driver_d *get_driver_by_name(const char *name)
 {
 	struct driver_d *drv;
@@ -292,7 +417,7 @@ struct driver_d *get_driver_by_name(const char *name)
 
 int register_driver(struct driver_d *drv)
 {
-	struct device_d *dev = NULL;
+	struct device_d *dev = NULL, **devs = NULL;
 
 	debug("register_driver: %s\n", drv->name);
 
@@ -301,8 +426,22 @@ int register_driver(struct driver_d *drv)
 	list_add_tail(&drv->list, &driver_list);
 	list_add_tail(&drv->bus_list, &drv->bus->driver_list);
 
-	bus_for_each_device(drv->bus, dev)
+	if (IS_ENABLED(CONFIG_OFDEVICE) && drv->of_compatible) {
+		of_driver_index_add(drv);
+		devs = of_device_index_lookup(drv);
+	}
+
+	bus_for_each_device(drv->bus, dev) {
+		if (match_by_index(dev, drv) && !device_in_list(devs, dev)) {
+			match_avoided++;
+			continue;
+		}
+
+		match_tried++;
 		match(drv, dev);
+	}
+
+	free(devs);
 
 	return 0;
 }
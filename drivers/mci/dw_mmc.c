@@ -386,13 +386,16 @@ static int dwmci_write_data_pio(struct dwmci_host *host, struct mci_data *data)
 	return wlen;
 }
 
+/*
+ * Send a command and wait for its response. A data transfer is started,
+ * but dwmci_complete() has to be called to wait for it.
+ */
 static int
-dwmci_cmd(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
+dwmci_submit(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
 {
 	struct dwmci_host *host = to_dwmci_host(mci);
 	int flags = 0;
 	uint32_t mask;
-	uint32_t ctrl;
 	uint64_t start;
 	int ret;
 	unsigned int num_bytes = 0;
@@ -486,7 +489,21 @@ dwmci_cmd(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
 		}
 	}
 
+	return 0;
+}
+
+static int
+dwmci_complete(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
+{
+	struct dwmci_host *host = to_dwmci_host(mci);
+	uint32_t mask;
+	uint32_t ctrl;
+	uint64_t start;
+	unsigned int num_bytes;
+
 	if (data) {
+		num_bytes = data->blocks * data->blocksize;
+
 		start = get_time_ns();
 		do {
 			mask = dwmci_readl(host, DWMCI_RINTSTS);
@@ -537,6 +554,18 @@ dwmci_cmd(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
 	return 0;
 }
 
+static int
+dwmci_cmd(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
+{
+	int ret;
+
+	ret = dwmci_submit(mci, cmd, data);
+	if (ret)
+		return ret;
+
+	return dwmci_complete(mci, cmd, data);
+}
+
 static int dwmci_send_cmd(struct dwmci_host *host, u32 cmd, u32 arg)
 {
 	uint64_t start = get_time_ns();
@@ -716,6 +745,10 @@ static int dw_mmc_probe(struct device_d *dev)
 					 DMA_ADDRESS_BROKEN);
 
 	host->mci.send_cmd = dwmci_cmd;
+	if (!dwmci_use_pio(host)) {
+		host->mci.submit = dwmci_submit;
+		host->mci.complete = dwmci_complete;
+	}
 	host->mci.set_ios = dwmci_set_ios;
 	host->mci.init = dwmci_init;
 	host->mci.card_present = dwmci_card_present;
@@ -736,6 +769,7 @@ static int dw_mmc_probe(struct device_d *dev)
 	if (host->mci.f_min < 200000)
 		host->mci.f_min = 200000;
 	host->mci.f_max = host->clkrate / host->ciu_div;
+	host->mci.max_blk_count = DW_MMC_NUM_IDMACS;
 
 	mci_of_parse(&host->mci);
 
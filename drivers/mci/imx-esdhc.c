@@ -233,11 +233,12 @@ static int esdhc_do_data(struct mci_host *mci, struct mci_data *data)
 }
 
 /*
- * Sends a command out on the bus.  Takes the mci pointer,
- * a command pointer, and an optional data pointer.
+ * Sends a command out on the bus and waits for the response, but not
+ * for the data transfer. Takes the mci pointer, a command pointer, and
+ * an optional data pointer.
  */
 static int
-esdhc_send_cmd(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
+esdhc_submit(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
 {
 	u32	xfertyp, mixctrl;
 	u32	irqstat;
@@ -333,6 +334,20 @@ esdhc_send_cmd(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
 	} else
 		cmd->response[0] = esdhc_read32(regs + SDHCI_RESPONSE_0);
 
+	return 0;
+}
+
+/*
+ * Waits for the data transfer of a command started with esdhc_submit()
+ * to finish.
+ */
+static int
+esdhc_complete(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
+{
+	struct fsl_esdhc_host *host = to_fsl_esdhc(mci);
+	void __iomem *regs = host->regs;
+	int ret;
+
 	/* Wait until all of the blocks are transferred */
 	if (data) {
 		ret = esdhc_do_data(mci, data);
@@ -361,6 +376,22 @@ esdhc_send_cmd(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
 	return 0;
 }
 
+/*
+ * Sends a command out on the bus.  Takes the mci pointer,
+ * a command pointer, and an optional data pointer.
+ */
+static int
+esdhc_send_cmd(struct mci_host *mci, struct mci_cmd *cmd, struct mci_data *data)
+{
+	int ret;
+
+	ret = esdhc_submit(mci, cmd, data);
+	if (ret)
+		return ret;
+
+	return esdhc_complete(mci, cmd, data);
+}
+
 static void set_sysctl(struct mci_host *mci, u32 clock)
 {
 	int div, pre_div;
@@ -597,6 +628,10 @@ static int fsl_esdhc_probe(struct device_d *dev)
 		mci->host_caps |= MMC_CAP_MMC_HIGHSPEED | MMC_CAP_SD_HIGHSPEED;
 
 	host->mci.send_cmd = esdhc_send_cmd;
+	if (!IS_ENABLED(CONFIG_MCI_IMX_ESDHC_PIO)) {
+		host->mci.submit = esdhc_submit;
+		host->mci.complete = esdhc_complete;
+	}
 	host->mci.set_ios = esdhc_set_ios;
 	host->mci.init = esdhc_init;
 	host->mci.card_present = esdhc_card_present;
@@ -609,6 +644,8 @@ static int fsl_esdhc_probe(struct device_d *dev)
 	if (host->mci.f_min < 200000)
 		host->mci.f_min = 200000;
 	host->mci.f_max = rate;
+	/* the block count register field is 16 bit wide */
+	host->mci.max_blk_count = 65535;
 	if (pdata) {
 		host->mci.use_dsr = pdata->use_dsr;
 		host->mci.dsr_val = pdata->dsr_val;
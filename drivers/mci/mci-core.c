@@ -72,17 +72,23 @@ static inline unsigned mci_caps(struct mci *mci)
 	return mci->card_caps & mci->host->host_caps;
 }
 
+static void mci_queue_drain(struct mci *mci);
+
 /**
  * Call the MMC/SD instance driver to run the command on the MMC/SD card
  * @param mci MCI instance
  * @param cmd The information about the command to run
  * @param data The data according to the command (can be NULL)
  * @return Driver's answer (0 on success)
+ *
+ * Asynchronous reads still on the bus are finished first.
  */
 static int mci_send_cmd(struct mci *mci, struct mci_cmd *cmd, struct mci_data *data)
 {
 	struct mci_host *host = mci->host;
 
+	mci_queue_drain(mci);
+
 	return host->send_cmd(mci->host, cmd, data);
 }
 
@@ -187,12 +193,9 @@ static int mci_block_write(struct mci *mci, const void *src, int blocknum,
  * @param blocknum Block number to read
  * @param blocks number of blocks to read
  */
-static int mci_read_block(struct mci *mci, void *dst, int blocknum,
-		int blocks)
+static void mci_setup_read(struct mci *mci, struct mci_cmd *cmd,
+		struct mci_data *data, void *dst, int blocknum, int blocks)
 {
-	struct mci_cmd cmd;
-	struct mci_data data;
-	int ret;
 	unsigned mmccmd;
 
 	if (blocks > 1)
@@ -200,15 +203,25 @@ static int mci_read_block(struct mci *mci, void *dst, int blocknum,
 	else
 		mmccmd = MMC_CMD_READ_SINGLE_BLOCK;
 
-	mci_setup_cmd(&cmd,
+	mci_setup_cmd(cmd,
 		mmccmd,
 		mci->high_capacity != 0 ? blocknum : blocknum * mci->read_bl_len,
 		MMC_RSP_R1);
 
-	data.dest = dst;
-	data.blocks = blocks;
-	data.blocksize = mci->read_bl_len;
-	data.flags = MMC_DATA_READ;
+	data->dest = dst;
+	data->blocks = blocks;
+	data->blocksize = mci->read_bl_len;
+	data->flags = MMC_DATA_READ;
+}
+
+static int mci_read_block(struct mci *mci, void *dst, int blocknum,
+		int blocks)
+{
+	struct mci_cmd cmd;
+	struct mci_data data;
+	int ret;
+
+	mci_setup_read(mci, &cmd, &data, dst, blocknum, blocks);
 
 	ret = mci_send_cmd(mci, &cmd, &data);
 
@@ -665,6 +678,8 @@ static void mci_set_ios(struct mci *mci)
 	ios.bus_width = host->bus_width;
 	ios.clock = host->clock;
 
+	mci_queue_drain(mci);
+
 	host->set_ios(host, &ios);
 }
 
@@ -1247,6 +1262,161 @@ static int mci_blk_part_switch(struct mci_part *part)
 
 /* ------------------ attach to the blocklayer --------------------------- */
 
+/*
+ * Asynchronous reads. Hosts implementing the submit/complete operations
+ * can start a data transfer without waiting for it to finish. The core
+ * queues up to MCI_QUEUE_DEPTH requests: the one at the head of the queue
+ * is on the bus. There is no interrupt, so the transfers only advance
+ * when the caller waits: the next request is started once the one on the
+ * bus has been completed. The bus stays busy while the caller processes
+ * the data of the previous request. Any other command drains the queue,
+ * see mci_send_cmd().
+ */
+#define MCI_QUEUE_DEPTH	2
+
+static void mci_queue_finish(struct mci *mci, struct block_request *req,
+		int status)
+{
+	list_del(&req->list);
+	mci->queue_len--;
+	mci->queue_pos = 0;
+	req->status = status;
+}
+
+/*
+ * The maximum number of blocks of @bl_len bytes the host can transfer
+ * with a single command
+ */
+static unsigned mci_max_req_blocks(struct mci *mci, unsigned bl_len)
+{
+	struct mci_host *host = mci->host;
+	unsigned max = UINT_MAX;
+
+	if (host->max_req_size)
+		max = host->max_req_size / bl_len;
+	if (host->max_blk_count)
+		max = min(max, host->max_blk_count);
+
+	return max;
+}
+
+/*
+ * Start the transfer for the request at the head of the queue
+ */
+static void mci_queue_start(struct mci *mci)
+{
+	struct mci_host *host = mci->host;
+	struct block_request *req;
+	struct mci_part *part;
+	struct mci_cmd cmd;
+	int blocks, ret;
+
+	while (!mci->queue_active && !list_empty(&mci->queue)) {
+		req = list_first_entry(&mci->queue, struct block_request, list);
+		part = container_of(req->blk, struct mci_part, blk);
+
+		blocks = min_t(unsigned, req->num_blocks - mci->queue_pos,
+				mci_max_req_blocks(mci, mci->read_bl_len));
+
+		ret = mci_blk_part_switch(part);
+		if (ret) {
+			mci_queue_finish(mci, req, ret);
+			continue;
+		}
+
+		mci_setup_read(mci, &mci->queue_cmd, &mci->queue_data,
+				req->buf + mci->queue_pos * mci->read_bl_len,
+				req->block + mci->queue_pos, blocks);
+
+		ret = host->submit(host, &mci->queue_cmd, &mci->queue_data);
+		if (ret) {
+			dev_dbg(&mci->dev, "Reading block %d failed with %d\n",
+					req->block + mci->queue_pos, ret);
+			mci_setup_cmd(&cmd, MMC_CMD_STOP_TRANSMISSION, 0, MMC_RSP_R1b);
+			mci_send_cmd(mci, &cmd, NULL);
+			mci_queue_finish(mci, req, ret);
+			continue;
+		}
+
+		mci->queue_active = 1;
+	}
+}
+
+/*
+ * Wait for the transfer on the bus to finish and start the next one
+ */
+static void mci_queue_complete_one(struct mci *mci)
+{
+	struct mci_host *host = mci->host;
+	struct block_request *req;
+	struct mci_cmd cmd;
+	int ret;
+
+	req = list_first_entry(&mci->queue, struct block_request, list);
+
+	ret = host->complete(host, &mci->queue_cmd, &mci->queue_data);
+	mci->queue_active = 0;
+
+	if (ret || mci->queue_data.blocks > 1) {
+		mci_setup_cmd(&cmd, MMC_CMD_STOP_TRANSMISSION, 0, MMC_RSP_R1b);
+		mci_send_cmd(mci, &cmd, NULL);
+	}
+
+	if (ret)
+		dev_dbg(&mci->dev, "Reading block %d failed with %d\n",
+				req->block + mci->queue_pos, ret);
+
+	mci->queue_pos += mci->queue_data.blocks;
+
+	if (ret || mci->queue_pos == req->num_blocks)
+		mci_queue_finish(mci, req, ret);
+
+	mci_queue_start(mci);
+}
+
+/*
+ * Finish all queued requests. Called before issuing any other command
+ * to the card.
+ */
+static void mci_queue_drain(struct mci *mci)
+{
+	while (mci->queue_active)
+		mci_queue_complete_one(mci);
+}
+
+static int mci_sd_submit(struct block_device *blk, struct block_request *req)
+{
+	struct mci_part *part = container_of(blk, struct mci_part, blk);
+	struct mci *mci = part->mci;
+
+	if (mci->read_bl_len != 512)
+		return -EINVAL;
+
+	if (req->block > MAX_BUFFER_NUMBER)
+		return -EINVAL;
+
+	while (mci->queue_len >= MCI_QUEUE_DEPTH)
+		mci_queue_complete_one(mci);
+
+	list_add_tail(&req->list, &mci->queue);
+	mci->queue_len++;
+
+	mci_queue_start(mci);
+
+	return 0;
+}
+
+static int mci_sd_complete(struct block_device *blk, struct block_request *req)
+{
+	struct mci_part *part = container_of(blk, struct mci_part, blk);
+	struct mci *mci = part->mci;
+
+	while (req->status == -EINPROGRESS)
+		mci_queue_complete_one(mci);
+
+	return req->status;
+}
+
 /**
  * Write a chunk of sectors to media
  * @param blk All info about the block device we need
@@ -1264,12 +1434,9 @@ static int __maybe_unused mci_sd_write(struct block_device *blk,
 	struct mci *mci = part->mci;
 	struct mci_host *host = mci->host;
 	int rc;
-	unsigned max_req_block = num_blocks;
+	unsigned max_req_block = mci_max_req_blocks(mci, mci->write_bl_len);
 	int write_block;
 
-	if (mci->host->max_req_size)
-		max_req_block = mci->host->max_req_size / mci->write_bl_len;
-
 	mci_blk_part_switch(part);
 
 	if (host->card_write_protected && host->card_write_protected(host)) {
@@ -1322,13 +1489,10 @@ static int mci_sd_read(struct block_device *blk, void *buffer, int block,
 {
 	struct mci_part *part = container_of(blk, struct mci_part, blk);
 	struct mci *mci = part->mci;
-	unsigned max_req_block = num_blocks;
+	unsigned max_req_block = mci_max_req_blocks(mci, mci->read_bl_len);
 	int read_block;
 	int rc;
 
-	if (mci->host->max_req_size)
-		max_req_block = mci->host->max_req_size / mci->read_bl_len;
-
 	mci_blk_part_switch(part);
 
 	dev_dbg(&mci->dev, "%s: Read %d block(s), starting at %d\n",
@@ -1540,6 +1704,15 @@ static struct block_device_ops mci_ops = {
 #endif
 };
 
+static struct block_device_ops mci_async_ops = {
+	.read = mci_sd_read,
+#ifdef CONFIG_BLOCK_WRITE
+	.write = mci_sd_write,
+#endif
+	.submit = mci_sd_submit,
+	.complete = mci_sd_complete,
+};
+
 static int mci_set_boot(struct param_d *param, void *priv)
 {
 	struct mci *mci = priv;
@@ -1639,7 +1812,12 @@ static int mci_card_probe(struct mci *mci)
 		 * So, re-use the disk driver to gain access to this media
 		 */
 		part->blk.dev = &mci->dev;
-		part->blk.ops = &mci_ops;
+		if (host->submit && host->complete)
+			part->blk.ops = &mci_async_ops;
+		else
+			part->blk.ops = &mci_ops;
+		part->blk.max_req_blocks = min_t(unsigned, INT_MAX,
+				mci_max_req_blocks(mci, SECTOR_SIZE));
 
 		rc = blockdevice_register(&part->blk);
 		if (rc != 0) {
@@ -1744,6 +1922,7 @@ int mci_register(struct mci_host *host)
 
 	mci = xzalloc(sizeof(*mci));
 	mci->host = host;
+	INIT_LIST_HEAD(&mci->queue);
 
 	if (host->devname) {
 		strcpy(mci->dev.name, host->devname);
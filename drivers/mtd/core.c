@@ -145,6 +145,24 @@ static int mtd_erase_align(struct mtd_info *mtd, size_t *count, loff_t *offset)
 	return 0;
 }
 
+/*
+ * Drop the cached state of a block, e.g. after a bad block has been erased
+ * with allow_erasebad and might have lost its marker.
+ */
+static void mtd_bb_forget(struct mtd_info *mtd, loff_t ofs)
+{
+	if (mtd->master) {
+		ofs += mtd->master_offset;
+		mtd = mtd->master;
+	}
+
+	if (!mtd->bb_known || ofs >= mtd->size)
+		return;
+
+	__clear_bit(mtd_div_by_eb(ofs, mtd), mtd->bb_known);
+	mtd->bb_generation++;
+}
+
 static int mtd_op_erase(struct cdev *cdev, size_t count, loff_t offset)
 {
 	struct mtd_info *mtd = cdev->priv;
@@ -184,6 +202,9 @@ static int mtd_op_erase(struct cdev *cdev, size_t count, loff_t offset)
 			ret = mtd_erase(mtd, &erase);
 			if (ret)
 				return ret;
+			if (mtd->allow_erasebad ||
+					(mtd->master && mtd->master->allow_erasebad))
+				mtd_bb_forget(mtd, addr);
 		}
 
 		addr += mtd->erasesize;
@@ -295,15 +316,57 @@ int mtd_unlock(struct mtd_info *mtd, loff_t ofs, uint64_t len)
 	return mtd->unlock(mtd, ofs, len);
 }
 
+/*
+ * The bad block status of a master device is cached in two bitmaps, one
+ * telling which blocks have been asked for and one holding the answer.
+ * Partitions and the bad block aware cdevs on top of a device all end up
+ * here, so the driver (which might have to read the OOB marker when there
+ * is no RAM based BBT) is asked at most once per block.
+ */
+static void mtd_bb_cache_alloc(struct mtd_info *mtd)
+{
+	unsigned int nblocks = mtd_div_by_eb(mtd->size, mtd);
+
+	if (mtd->bb_known)
+		return;
+
+	mtd->bb_known = xzalloc(BITS_TO_LONGS(nblocks) * sizeof(long));
+	mtd->bb_bad = xzalloc(BITS_TO_LONGS(nblocks) * sizeof(long));
+}
+
 int mtd_block_isbad(struct mtd_info *mtd, loff_t ofs)
 {
+	unsigned int block;
+	int ret;
+
 	if (!mtd->block_isbad)
 		return 0;
 
 	if (ofs < 0 || ofs > mtd->size)
 		return -EINVAL;
 
-	return mtd->block_isbad(mtd, ofs);
+	/*
+	 * partitions forward to their master, which holds the cache, and
+	 * devices made of others to their parts
+	 */
+	if (mtd->master || mtd->get_bb_generation || ofs == mtd->size)
+		return mtd->block_isbad(mtd, ofs);
+
+	mtd_bb_cache_alloc(mtd);
+
+	block = mtd_div_by_eb(ofs, mtd);
+	if (test_bit(block, mtd->bb_known))
+		return test_bit(block, mtd->bb_bad);
+
+	ret = mtd->block_isbad(mtd, ofs);
+	if (ret < 0)
+		return ret;
+
+	__set_bit(block, mtd->bb_known);
+	if (ret)
+		__set_bit(block, mtd->bb_bad);
+
+	return ret;
 }
 
 int mtd_block_markbad(struct mtd_info *mtd, loff_t ofs)
@@ -315,6 +378,14 @@ int mtd_block_markbad(struct mtd_info *mtd, loff_t ofs)
 	else
 		ret = -ENOSYS;
 
+	if (!ret && !mtd->master && mtd->bb_known && ofs < mtd->size) {
+		unsigned int block = mtd_div_by_eb(ofs, mtd);
+
+		__set_bit(block, mtd->bb_known);
+		__set_bit(block, mtd->bb_bad);
+		mtd->bb_generation++;
+	}
+
 	return ret;
 }
 
@@ -681,6 +752,8 @@ int del_mtd_device (struct mtd_info *mtd)
 	unregister_device(&mtd->class_dev);
 	free(mtd->param_size.value);
 	free(mtd->cdev.name);
+	free(mtd->bb_known);
+	free(mtd->bb_bad);
 	if (mtd->master)
 		list_del(&mtd->partitions_entry);
 
@@ -505,6 +505,19 @@ static int concat_block_markbad(struct mtd_info *mtd, loff_t ofs)
 	return err;
 }
 
+static unsigned int concat_bb_generation(struct mtd_info *mtd)
+{
+	struct mtd_concat *concat = CONCAT(mtd);
+	unsigned int generation = 0;
+	int i;
+
+	/* changes whenever the status of a block of any subdevice changes */
+	for (i = 0; i < concat->num_subdev; i++)
+		generation += mtd_bb_generation(concat->subdev[i]);
+
+	return generation;
+}
+
 /*
  * This function constructs a virtual MTD device by concatenating
  * num_devs MTD devices. A pointer to the new device object is
@@ -564,6 +577,7 @@ struct mtd_info *mtd_concat_create(struct mtd_info *subdev[],	/* subdevices to c
 		concat->mtd.block_isbad = concat_block_isbad;
 	if (subdev[0]->block_markbad)
 		concat->mtd.block_markbad = concat_block_markbad;
+	concat->mtd.get_bb_generation = concat_bb_generation;
 
 	concat->mtd.ecc_stats.badblocks = subdev[0]->ecc_stats.badblocks;
 
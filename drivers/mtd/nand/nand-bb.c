@@ -45,8 +45,79 @@ struct nand_bb {
 	struct cdev cdev;
 
 	struct list_head list;
+
+	/*
+	 * Bad block bitmap of the underlying device plus the number of good
+	 * blocks before each bitmap word, used to translate offsets without
+	 * walking the device from block 0. Rebuilt when the bad block status
+	 * of the device changes, see mtd_bb_generation().
+	 */
+	unsigned int nblocks;
+	unsigned int ngood;
+	unsigned long *bad;
+	unsigned int *good_before;
+	unsigned int generation;
 };
 
+static void nand_bb_build_index(struct nand_bb *bb)
+{
+	unsigned int block, words = BITS_TO_LONGS(bb->nblocks);
+
+	bb->generation = mtd_bb_generation(bb->mtd);
+	memset(bb->bad, 0, words * sizeof(long));
+	bb->ngood = 0;
+
+	for (block = 0; block < bb->nblocks; block++) {
+		if (!(block % BITS_PER_LONG))
+			bb->good_before[block / BITS_PER_LONG] = bb->ngood;
+
+		if (mtd_block_isbad(bb->mtd, (loff_t)block * bb->mtd->erasesize))
+			__set_bit(block, bb->bad);
+		else
+			bb->ngood++;
+	}
+
+	bb->cdev.size = (loff_t)bb->ngood * bb->mtd->erasesize;
+}
+
+static void nand_bb_update_index(struct nand_bb *bb)
+{
+	if (bb->generation != mtd_bb_generation(bb->mtd))
+		nand_bb_build_index(bb);
+}
+
+/*
+ * Find the raw block number of the good block with index @good, using a
+ * binary search over the per-word prefix counts. Returns -1 if there are
+ * not that many good blocks.
+ */
+static int nand_bb_good_to_raw(struct nand_bb *bb, unsigned int good)
+{
+	unsigned int lo = 0, hi = BITS_TO_LONGS(bb->nblocks), mid, block;
+
+	if (good >= bb->ngood)
+		return -1;
+
+	/* last word whose good_before is <= good */
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (bb->good_before[mid] <= good)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	good -= bb->good_before[lo];
+	for (block = lo * BITS_PER_LONG; block < bb->nblocks; block++) {
+		if (test_bit(block, bb->bad))
+			continue;
+		if (!good--)
+			return block;
+	}
+
+	return -1;
+}
+
 static ssize_t nand_bb_read(struct cdev *cdev, void *buf, size_t count,
 	loff_t offset, ulong flags)
 {
@@ -199,6 +270,8 @@ static int nand_bb_open(struct cdev *cdev, unsigned long flags)
 	if (bb->open)
 		return -EBUSY;
 
+	nand_bb_update_index(bb);
+
 	bb->flags = flags;
 	bb->open = 1;
 	bb->offset = 0;
@@ -222,46 +295,33 @@ static int nand_bb_close(struct cdev *cdev)
 	return 0;
 }
 
-static int nand_bb_calc_size(struct nand_bb *bb)
-{
-	loff_t pos = 0;
-
-	while (pos < bb->mtd->size) {
-		if (!mtd_block_isbad(bb->mtd, pos))
-			bb->cdev.size += bb->mtd->erasesize;
-
-		pos += bb->mtd->erasesize;
-	}
-
-	return 0;
-}
-
 static loff_t nand_bb_lseek(struct cdev *cdev, loff_t __offset)
 {
 	struct nand_bb *bb = cdev->priv;
-	loff_t raw_pos = 0;
-	uint32_t offset = __offset;
+	loff_t erasesize = bb->mtd->erasesize;
+	int block;
 
 	/* lseek only in readonly mode */
 	if (bb->flags & O_ACCMODE)
 		return -ENOSYS;
-	while (raw_pos < bb->mtd->size) {
-		off_t now = min(offset, bb->mtd->erasesize);
 
-		if (mtd_block_isbad(bb->mtd, raw_pos)) {
-			raw_pos += bb->mtd->erasesize;
-		} else {
-			offset -= now;
-			raw_pos += now;
-		}
+	nand_bb_update_index(bb);
 
-		if (!offset) {
-			bb->offset = raw_pos;
-			return __offset;
-		}
+	if (__offset < 0 || __offset > cdev->size)
+		return -EINVAL;
+
+	if (__offset == cdev->size) {
+		bb->offset = bb->mtd->size;
+		return __offset;
 	}
 
-	return -EINVAL;
+	block = nand_bb_good_to_raw(bb, mtd_div_by_eb(__offset, bb->mtd));
+	if (block < 0)
+		return -EINVAL;
+
+	bb->offset = block * erasesize + mtd_mod_by_eb(__offset, bb->mtd);
+
+	return __offset;
 }
 
 static struct file_operations nand_bb_ops = {
@@ -290,7 +350,12 @@ struct cdev *mtd_add_bb(struct mtd_info *mtd, const char *name)
 	else
 		bb->cdev.name = asprintf("%s.bb", mtd->cdev.name);
 
-	nand_bb_calc_size(bb);
+	bb->nblocks = mtd_div_by_eb(mtd->size, mtd);
+	bb->bad = xzalloc(BITS_TO_LONGS(bb->nblocks) * sizeof(long));
+	bb->good_before = xzalloc(BITS_TO_LONGS(bb->nblocks) *
+			sizeof(*bb->good_before));
+	nand_bb_build_index(bb);
+
 	bb->cdev.ops = &nand_bb_ops;
 	bb->cdev.priv = bb;
 
@@ -303,6 +368,8 @@ struct cdev *mtd_add_bb(struct mtd_info *mtd, const char *name)
 	return &bb->cdev;
 
 err:
+	free(bb->good_before);
+	free(bb->bad);
 	free(bb);
 	return ERR_PTR(ret);
 }
@@ -315,6 +382,8 @@ void mtd_del_bb(struct mtd_info *mtd)
 	devfs_remove(&bb->cdev);
 	list_del_init(&bb->list);
 	free(bb->name);
+	free(bb->good_before);
+	free(bb->bad);
 	free(bb);
 }
 
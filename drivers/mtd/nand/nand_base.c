@@ -1334,6 +1334,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 			    struct mtd_oob_ops *ops)
 {
 	int chipnr, page, realpage, col, bytes, aligned, oob_required;
+	int cache_read = 0, cache_mask;
 	struct nand_chip *chip = mtd->priv;
 	struct mtd_ecc_stats stats;
 	int ret = 0;
@@ -1359,6 +1360,9 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	oob = ops->oobbuf;
 	oob_required = oob ? 1 : 0;
 
+	/* Cache reads stop at eraseblock boundaries */
+	cache_mask = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
+
 	while (1) {
 		bytes = min(mtd->writesize - col, readlen);
 		aligned = (bytes == mtd->writesize);
@@ -1367,7 +1371,27 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		if (realpage != chip->pagebuf || oob) {
 			bufpoi = aligned ? buf : chip->buffers->databuf;
 
-			chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+			/*
+			 * With the read cache the chip loads the next page
+			 * from the array while this one is transferred.
+			 * Start a sequence when more pages of this eraseblock
+			 * follow, and end it with the last one.
+			 */
+			if (!cache_read)
+				chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+
+			if (NAND_HAS_CACHE_READ(chip) &&
+			    ops->mode != MTD_OPS_RAW && readlen > bytes &&
+			    ((realpage + 1) & cache_mask) &&
+			    realpage + 1 != chip->pagebuf) {
+				chip->cmdfunc(mtd, NAND_CMD_READCACHESEQ,
+					      -1, -1);
+				cache_read = 1;
+			} else if (cache_read) {
+				chip->cmdfunc(mtd, NAND_CMD_READCACHEEND,
+					      -1, -1);
+				cache_read = 0;
+			}
 
 			/*
 			 * Now read the page into the buffer.  Absent an error,
@@ -1388,6 +1412,9 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 				if (!aligned)
 					/* Invalidate page cache */
 					chip->pagebuf = -1;
+				if (cache_read)
+					chip->cmdfunc(mtd,
+						NAND_CMD_READCACHEEND, -1, -1);
 				break;
 			}
 
@@ -2823,6 +2850,9 @@ static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
 	if (le16_to_cpu(p->features) & 1)
 		*busw = NAND_BUSWIDTH_16;
 
+	if (le16_to_cpu(p->opt_cmd) & ONFI_OPT_CMD_READ_CACHE)
+		chip->options |= NAND_CACHE_READ;
+
 	pr_info("ONFI flash detected\n");
 	return 1;
 }
@@ -3553,6 +3583,18 @@ int nand_scan_tail(struct mtd_info *mtd)
 	}
 	chip->subpagesize = mtd->writesize >> mtd->subpage_sft;
 
+	/*
+	 * The read cache commands only make it to the chip through the generic
+	 * command function, and the page read functions must be plain data
+	 * transfers which do not issue commands on their own.
+	 */
+	if (chip->cmdfunc != nand_command_lp ||
+	    chip->ecc.read_page_raw != nand_read_page_raw ||
+	    (chip->ecc.read_page != nand_read_page_swecc &&
+	     chip->ecc.read_page != nand_read_page_hwecc &&
+	     chip->ecc.read_page != nand_read_page_raw))
+		chip->options &= ~NAND_CACHE_READ;
+
 	/* Initialize state */
 	chip->state = FL_READY;
 
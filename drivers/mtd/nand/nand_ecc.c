@@ -36,6 +36,8 @@
 #include <linux/types.h>
 #include <common.h>
 #include <errno.h>
+#include <asm/unaligned.h>
+#include <linux/bitops.h>
 #include <linux/mtd/nand_ecc.h>
 
 /*
@@ -60,33 +62,71 @@ static const u_char nand_ecc_precalc_table[] = {
 	0x00, 0x55, 0x56, 0x03, 0x59, 0x0c, 0x0f, 0x5a, 0x5a, 0x0f, 0x0c, 0x59, 0x03, 0x56, 0x55, 0x00
 };
 
+/*
+ * Parity of a 32 bit word, folded down to a byte and looked up in the
+ * all-bit XOR column (0x40) of the precalculated table.
+ */
+static inline unsigned int nand_ecc_parity(uint32_t w)
+{
+	w ^= w >> 16;
+	w ^= w >> 8;
+
+	return (nand_ecc_precalc_table[w & 0xff] >> 6) & 1;
+}
+
 /**
  * nand_calculate_ecc - [NAND Interface] Calculate 3-byte ECC for 256-byte block
  * @mtd:	MTD block structure
  * @dat:	raw data
  * @ecc_code:	buffer for ECC
+ *
+ * The block is processed as 64 little endian 32 bit words instead of byte by
+ * byte. Line parity bits for byte address bits 2..7 are the parities of the
+ * XOR of all words whose word index has the corresponding bit set, and are
+ * collected by pairwise folding the words in log2(64) rounds. Address bits 0
+ * and 1 select bytes within a word and fall out of the final XOR of all words,
+ * which also yields the column parity through the byte table.
  */
 int nand_calculate_ecc(struct mtd_info *mtd, const u_char *dat,
 		       u_char *ecc_code)
 {
-	uint8_t idx, reg1, reg2, reg3, tmp1, tmp2;
-	int i;
-
-	/* Initialize variables */
-	reg1 = reg2 = reg3 = 0;
-
-	/* Build up column parity */
-	for(i = 0; i < 256; i++) {
-		/* Get CP0 - CP5 from table */
-		idx = nand_ecc_precalc_table[*dat++];
-		reg1 ^= (idx & 0x3f);
-
-		/* All bit XOR = 1 ? */
-		if (idx & 0x40) {
-			reg3 ^= (uint8_t) i;
-			reg2 ^= ~((uint8_t) i);
+	uint32_t fold[32], rp[6] = { 0 }, par;
+	uint8_t reg1, reg2, reg3, tmp1, tmp2;
+	unsigned int i, k, n, total;
+
+	/* First round: XOR word pairs, odd words give address bit 2 */
+	for (k = 0; k < 32; k++) {
+		uint32_t even = get_unaligned_le32(dat + 8 * k);
+		uint32_t odd = get_unaligned_le32(dat + 8 * k + 4);
+
+		rp[0] ^= odd;
+		fold[k] = even ^ odd;
+	}
+
+	/* Remaining rounds for address bits 3..7 */
+	for (i = 1, n = 32; i < 6; i++) {
+		n >>= 1;
+		for (k = 0; k < n; k++) {
+			rp[i] ^= fold[2 * k + 1];
+			fold[k] = fold[2 * k] ^ fold[2 * k + 1];
 		}
 	}
+	par = fold[0];
+
+	total = nand_ecc_parity(par);
+
+	reg3 = nand_ecc_parity(par & 0xff00ff00);
+	reg3 |= nand_ecc_parity(par & 0xffff0000) << 1;
+	for (i = 0; i < 6; i++)
+		reg3 |= nand_ecc_parity(rp[i]) << (i + 2);
+
+	/* The complementary line parity covers the other half of the bytes */
+	reg2 = reg3 ^ (total ? 0xff : 0x00);
+
+	/* Column parity of the whole block is the column parity of its XOR */
+	par ^= par >> 16;
+	par ^= par >> 8;
+	reg1 = nand_ecc_precalc_table[par & 0xff] & 0x3f;
 
 	/* Create non-inverted ECC code from line parity */
 	tmp1  = (reg3 & 0x80) >> 0; /* B7 -> B7 */
@@ -121,15 +161,6 @@ int nand_calculate_ecc(struct mtd_info *mtd, const u_char *dat,
 }
 EXPORT_SYMBOL(nand_calculate_ecc);
 
-static inline int countbits(uint32_t byte)
-{
-	int res = 0;
-
-	for (;byte; byte >>= 1)
-		res += byte & 0x01;
-	return res;
-}
-
 /**
  * nand_correct_data - [NAND Interface] Detect and correct bit error(s)
  * @mtd:	MTD block structure
@@ -182,7 +213,7 @@ int nand_correct_data(struct mtd_info *mtd, u_char *dat,
 		return 1;
 	}
 
-	if(countbits(s0 | ((uint32_t)s1 << 8) | ((uint32_t)s2 <<16)) == 1)
+	if (hweight32(s0 | ((uint32_t)s1 << 8) | ((uint32_t)s2 << 16)) == 1)
 		return 1;
 
 	return -EBADMSG;
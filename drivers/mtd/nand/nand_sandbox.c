@@ -0,0 +1,695 @@
+/*
+ * nand_sandbox.c - NAND flash simulator for the sandbox
+ *
+ * The flash contents are kept in a host file, every page is stored as its
+ * data followed by its OOB area. The chip is driven through the generic
+ * command function and identifies itself through an ONFI parameter page, so
+ * any geometry can be simulated. Array accesses are
+ * accounted with a simple latency model and can optionally be delayed for
+ * real, bitflips and bad blocks can be injected.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <common.h>
+#include <driver.h>
+#include <init.h>
+#include <malloc.h>
+#include <errno.h>
+#include <clock.h>
+#include <stdlib.h>
+#include <of.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/nand.h>
+#include <linux/bitmap.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <mach/linux.h>
+
+#define SANDBOX_NAND_ID		0x01	/* not in nand_flash_ids, use ONFI */
+
+struct sandbox_nand {
+	struct mtd_info mtd;
+	struct nand_chip chip;
+	struct device_d *dev;
+
+	int fd;
+	const char *filename;
+
+	/* geometry */
+	unsigned int pagesize;
+	unsigned int oobsize;
+	unsigned int pages_per_block;
+	unsigned int blocks;
+	unsigned long *bad;		/* injected bad blocks */
+
+	/* command and address cycles of the current operation */
+	u8 cmd;
+	u8 addr[5];
+	int naddr;
+
+	/* cache register, data register and the current output */
+	u8 *reg;
+	u8 *datareg;
+	int cache_page;			/* page in @datareg for cache reads */
+	const u8 *out;
+	unsigned int outlen;
+	unsigned int pos;
+	int page;
+	u8 status;
+	u8 id[8];
+	u8 features[4];
+	struct nand_onfi_params onfi;
+
+	/* latency model in us */
+	int t_r;
+	int t_rcbsy;
+	int t_prog;
+	int t_bers;
+	int delay;
+	int readcache;
+	int bitflips;
+
+	/* statistics */
+	int reads;
+	int programs;
+	int erases;
+	int time_us;
+};
+
+static inline struct sandbox_nand *mtd_to_sandbox_nand(struct mtd_info *mtd)
+{
+	return container_of(mtd, struct sandbox_nand, mtd);
+}
+
+static unsigned int sandbox_nand_rawsize(struct sandbox_nand *priv)
+{
+	return priv->pagesize + priv->oobsize;
+}
+
+static int sandbox_nand_io(struct sandbox_nand *priv, int page, void *buf,
+		size_t len, int write)
+{
+	loff_t ofs = (loff_t)page * sandbox_nand_rawsize(priv);
+	ssize_t ret;
+
+	if (linux_lseek(priv->fd, ofs) != ofs)
+		return -EIO;
+
+	if (write)
+		ret = linux_write(priv->fd, buf, len);
+	else
+		ret = linux_read(priv->fd, buf, len);
+
+	return ret == len ? 0 : -EIO;
+}
+
+static void sandbox_nand_busy(struct sandbox_nand *priv, int us)
+{
+	priv->time_us += us;
+
+	if (priv->delay)
+		udelay(us);
+}
+
+static void sandbox_nand_set_out(struct sandbox_nand *priv, const void *buf,
+		unsigned int len, unsigned int pos)
+{
+	priv->out = buf;
+	priv->outlen = len;
+	priv->pos = pos;
+}
+
+/* Read a page from the array into @buf */
+static void sandbox_nand_read_page(struct sandbox_nand *priv, int page,
+		u8 *buf)
+{
+	unsigned int bit;
+	int i;
+
+	priv->reads++;
+
+	if (page < 0 || page >= priv->blocks * priv->pages_per_block ||
+	    sandbox_nand_io(priv, page, buf, sandbox_nand_rawsize(priv), 0)) {
+		memset(buf, 0xff, sandbox_nand_rawsize(priv));
+		return;
+	}
+
+	for (i = 0; i < priv->bitflips; i++) {
+		bit = random32() % (priv->pagesize * 8);
+		buf[bit / 8] ^= 1 << (bit % 8);
+	}
+}
+
+static void sandbox_nand_program(struct sandbox_nand *priv)
+{
+	unsigned int rawsize = sandbox_nand_rawsize(priv);
+	int block = priv->page / priv->pages_per_block;
+	u8 *old;
+	int i;
+
+	priv->programs++;
+	sandbox_nand_busy(priv, priv->t_prog);
+
+	if (priv->page < 0 || block >= priv->blocks ||
+	    test_bit(block, priv->bad)) {
+		priv->status |= NAND_STATUS_FAIL;
+		return;
+	}
+
+	/* programming can only clear bits */
+	old = xmalloc(rawsize);
+	if (!sandbox_nand_io(priv, priv->page, old, rawsize, 0)) {
+		for (i = 0; i < rawsize; i++)
+			old[i] &= priv->reg[i];
+		if (!sandbox_nand_io(priv, priv->page, old, rawsize, 1))
+			goto out;
+	}
+
+	priv->status |= NAND_STATUS_FAIL;
+out:
+	free(old);
+}
+
+static int sandbox_nand_erase_block(struct sandbox_nand *priv, int block)
+{
+	unsigned int len = sandbox_nand_rawsize(priv) * priv->pages_per_block;
+	void *buf;
+	int ret;
+
+	buf = xmalloc(len);
+	memset(buf, 0xff, len);
+	ret = sandbox_nand_io(priv, block * priv->pages_per_block, buf, len, 1);
+	free(buf);
+
+	return ret;
+}
+
+static void sandbox_nand_erase(struct sandbox_nand *priv, int page)
+{
+	int block = page / priv->pages_per_block;
+
+	priv->erases++;
+	sandbox_nand_busy(priv, priv->t_bers);
+
+	if (page < 0 || block >= priv->blocks || test_bit(block, priv->bad) ||
+	    sandbox_nand_erase_block(priv, block))
+		priv->status |= NAND_STATUS_FAIL;
+}
+
+static int sandbox_nand_row(struct sandbox_nand *priv, int first)
+{
+	int i, row = 0;
+
+	for (i = first; i < priv->naddr; i++)
+		row |= priv->addr[i] << (8 * (i - first));
+
+	return row;
+}
+
+static int sandbox_nand_column(struct sandbox_nand *priv)
+{
+	return priv->addr[0] | priv->addr[1] << 8;
+}
+
+/*
+ * Commands which take data right after their address cycles are set up
+ * when the address is complete, i.e. on the first data cycle or the next
+ * command.
+ */
+static void sandbox_nand_addr_done(struct sandbox_nand *priv)
+{
+	unsigned int rawsize = sandbox_nand_rawsize(priv);
+
+	if (!priv->naddr)
+		return;
+
+	switch (priv->cmd) {
+	case NAND_CMD_READID:
+		if (priv->addr[0] == 0x20)
+			sandbox_nand_set_out(priv, "ONFI", 4, 0);
+		else
+			sandbox_nand_set_out(priv, priv->id, sizeof(priv->id), 0);
+		break;
+	case NAND_CMD_PARAM:
+		sandbox_nand_set_out(priv, &priv->onfi, sizeof(priv->onfi), 0);
+		break;
+	case NAND_CMD_GET_FEATURES:
+		sandbox_nand_set_out(priv, priv->features, 4, 0);
+		break;
+	case NAND_CMD_SET_FEATURES:
+		sandbox_nand_set_out(priv, NULL, 0, 0);
+		break;
+	case NAND_CMD_SEQIN:
+		priv->page = sandbox_nand_row(priv, 2);
+		memset(priv->reg, 0xff, rawsize);
+		sandbox_nand_set_out(priv, priv->reg, rawsize,
+				     sandbox_nand_column(priv));
+		break;
+	case NAND_CMD_RNDIN:
+		priv->pos = sandbox_nand_column(priv);
+		break;
+	default:
+		/* these wait for their confirm command */
+		return;
+	}
+
+	priv->naddr = 0;
+}
+
+static void sandbox_nand_command(struct sandbox_nand *priv, u8 command)
+{
+	unsigned int rawsize = sandbox_nand_rawsize(priv);
+
+	sandbox_nand_addr_done(priv);
+
+	switch (command) {
+	case NAND_CMD_RESET:
+		priv->status = NAND_STATUS_READY | NAND_STATUS_WP;
+		priv->cache_page = -1;
+		sandbox_nand_set_out(priv, NULL, 0, 0);
+		break;
+	case NAND_CMD_READSTART:
+		priv->page = sandbox_nand_row(priv, 2);
+		priv->cache_page = -1;
+		sandbox_nand_busy(priv, priv->t_r);
+		sandbox_nand_read_page(priv, priv->page, priv->reg);
+		sandbox_nand_set_out(priv, priv->reg, rawsize,
+				     sandbox_nand_column(priv));
+		break;
+	case NAND_CMD_READCACHESEQ:
+	case NAND_CMD_READCACHEEND:
+		/*
+		 * The page loaded into the data register by the previous
+		 * READCACHESEQ moves to the cache register. READCACHESEQ
+		 * then loads the next page while the host reads the cache
+		 * register, so only tRCBSY is accounted for it, assuming the
+		 * transfer takes longer than tR.
+		 */
+		if (priv->cache_page >= 0) {
+			memcpy(priv->reg, priv->datareg, rawsize);
+			priv->page = priv->cache_page;
+			priv->cache_page = -1;
+		}
+		sandbox_nand_busy(priv, priv->t_rcbsy);
+		if (command == NAND_CMD_READCACHESEQ) {
+			priv->cache_page = priv->page + 1;
+			sandbox_nand_read_page(priv, priv->cache_page,
+					       priv->datareg);
+		}
+		sandbox_nand_set_out(priv, priv->reg, rawsize, 0);
+		break;
+	case NAND_CMD_RNDOUTSTART:
+		priv->pos = sandbox_nand_column(priv);
+		break;
+	case NAND_CMD_PAGEPROG:
+		priv->status &= ~NAND_STATUS_FAIL;
+		sandbox_nand_program(priv);
+		break;
+	case NAND_CMD_ERASE2:
+		priv->status &= ~NAND_STATUS_FAIL;
+		sandbox_nand_erase(priv, sandbox_nand_row(priv, 0));
+		break;
+	case NAND_CMD_STATUS:
+		sandbox_nand_set_out(priv, &priv->status, 1, 0);
+		break;
+	default:
+		break;
+	}
+
+	priv->cmd = command;
+	priv->naddr = 0;
+}
+
+static void sandbox_nand_cmd_ctrl(struct mtd_info *mtd, int dat,
+		unsigned int ctrl)
+{
+	struct sandbox_nand *priv = mtd_to_sandbox_nand(mtd);
+
+	if (dat == NAND_CMD_NONE)
+		return;
+
+	if (ctrl & NAND_CLE)
+		sandbox_nand_command(priv, dat);
+	else if ((ctrl & NAND_ALE) && priv->naddr < ARRAY_SIZE(priv->addr))
+		priv->addr[priv->naddr++] = dat;
+}
+
+static uint8_t sandbox_nand_read_byte(struct mtd_info *mtd)
+{
+	struct sandbox_nand *priv = mtd_to_sandbox_nand(mtd);
+
+	sandbox_nand_addr_done(priv);
+
+	if (!priv->outlen)
+		return 0;
+
+	/* the status register and the ID can be read repeatedly */
+	if (priv->pos >= priv->outlen)
+		priv->pos = 0;
+
+	return priv->out[priv->pos++];
+}
+
+static void sandbox_nand_read_buf(struct mtd_info *mtd, uint8_t *buf, int len)
+{
+	struct sandbox_nand *priv = mtd_to_sandbox_nand(mtd);
+	int now = 0;
+
+	sandbox_nand_addr_done(priv);
+
+	if (priv->out == priv->reg && priv->pos < priv->outlen) {
+		now = min_t(int, len, priv->outlen - priv->pos);
+		memcpy(buf, priv->reg + priv->pos, now);
+		priv->pos += now;
+	}
+
+	memset(buf + now, 0xff, len - now);
+}
+
+static void sandbox_nand_write_buf(struct mtd_info *mtd, const uint8_t *buf,
+		int len)
+{
+	struct sandbox_nand *priv = mtd_to_sandbox_nand(mtd);
+	int now;
+
+	sandbox_nand_addr_done(priv);
+
+	if (priv->out != priv->reg || priv->pos >= priv->outlen)
+		return;
+
+	now = min_t(int, len, priv->outlen - priv->pos);
+	memcpy(priv->reg + priv->pos, buf, now);
+	priv->pos += now;
+}
+
+static int sandbox_nand_dev_ready(struct mtd_info *mtd)
+{
+	return 1;
+}
+
+static u16 sandbox_nand_onfi_crc16(u16 crc, u8 const *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^ ((crc & 0x8000) ? 0x8005 : 0);
+	}
+
+	return crc;
+}
+
+static void sandbox_nand_init_onfi(struct sandbox_nand *priv)
+{
+	struct nand_onfi_params *p = &priv->onfi;
+
+	memcpy(p->sig, "ONFI", 4);
+	p->revision = cpu_to_le16(1 << 2);	/* ONFI 2.0 */
+	memcpy(p->manufacturer, "BAREBOX     ", 12);
+	memcpy(p->model, "SANDBOX NAND        ", 20);
+	p->byte_per_page = cpu_to_le32(priv->pagesize);
+	p->spare_bytes_per_page = cpu_to_le16(priv->oobsize);
+	p->pages_per_block = cpu_to_le32(priv->pages_per_block);
+	p->blocks_per_lun = cpu_to_le32(priv->blocks);
+	p->lun_count = 1;
+	p->addr_cycles = 0x23;
+	p->bits_per_cell = 1;
+	p->programs_per_page = 4;
+	if (priv->readcache)
+		p->opt_cmd = cpu_to_le16(ONFI_OPT_CMD_READ_CACHE);
+	p->t_prog = cpu_to_le16(priv->t_prog);
+	p->t_bers = cpu_to_le16(priv->t_bers);
+	p->t_r = cpu_to_le16(priv->t_r);
+	p->crc = cpu_to_le16(sandbox_nand_onfi_crc16(ONFI_CRC_BASE, (u8 *)p, 254));
+
+	priv->id[0] = NAND_MFR_MICRON;
+	priv->id[1] = SANDBOX_NAND_ID;
+}
+
+/*
+ * Parse "name=value" options separated by commas. Bad blocks are given as
+ * a colon separated list: "badblocks=3:17".
+ */
+static int sandbox_nand_parse_options(struct sandbox_nand *priv,
+		const char *options, char **badblocks, char **ecc)
+{
+	char *str, *s, *opt, *val;
+	int ret = 0;
+
+	str = s = xstrdup(options);
+
+	while ((opt = strsep(&s, ","))) {
+		if (!*opt)
+			continue;
+
+		val = strchr(opt, '=');
+		if (!val) {
+			ret = -EINVAL;
+			break;
+		}
+		*val++ = 0;
+
+		if (!strcmp(opt, "pagesize"))
+			priv->pagesize = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "oobsize"))
+			priv->oobsize = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "pages"))
+			priv->pages_per_block = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "blocks"))
+			priv->blocks = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "tR"))
+			priv->t_r = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "tRCBSY"))
+			priv->t_rcbsy = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "readcache"))
+			priv->readcache = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "tPROG"))
+			priv->t_prog = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "tBERS"))
+			priv->t_bers = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "delay"))
+			priv->delay = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "bitflips"))
+			priv->bitflips = simple_strtoul(val, NULL, 0);
+		else if (!strcmp(opt, "badblocks"))
+			*badblocks = xstrdup(val);
+		else if (!strcmp(opt, "ecc"))
+			*ecc = xstrdup(val);
+		else {
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	if (ret)
+		dev_err(priv->dev, "invalid option '%s'\n", opt);
+
+	free(str);
+
+	return ret;
+}
+
+/*
+ * Blocks beyond the end of the backing file are created in erased state.
+ * Bad blocks get a bad block marker in their first page.
+ */
+static int sandbox_nand_init_flash(struct sandbox_nand *priv, u64 size,
+		char *badblocks)
+{
+	unsigned int rawsize = sandbox_nand_rawsize(priv);
+	unsigned long block;
+	char *s;
+	int i, ret;
+
+	i = div_u64(size, rawsize * priv->pages_per_block);
+
+	for (; i < priv->blocks; i++) {
+		ret = sandbox_nand_erase_block(priv, i);
+		if (ret)
+			return ret;
+	}
+
+	while ((s = strsep(&badblocks, ":"))) {
+		block = simple_strtoul(s, NULL, 0);
+		if (block >= priv->blocks)
+			return -EINVAL;
+
+		set_bit(block, priv->bad);
+
+		memset(priv->reg, 0xff, rawsize);
+		memset(priv->reg + priv->pagesize, 0, 2);
+		ret = sandbox_nand_io(priv, block * priv->pages_per_block,
+				      priv->reg, rawsize, 1);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static void sandbox_nand_info(struct device_d *dev)
+{
+	struct sandbox_nand *priv = dev->priv;
+
+	printf("file: %s\n", priv->filename);
+	printf("geometry: %u+%u bytes per page, %u pages per block, %u blocks\n",
+	       priv->pagesize, priv->oobsize, priv->pages_per_block,
+	       priv->blocks);
+}
+
+static int sandbox_nand_probe(struct device_d *dev)
+{
+	struct sandbox_nand *priv;
+	struct nand_chip *chip;
+	struct mtd_info *mtd;
+	struct device_d *mtddev;
+	const char *options = "";
+	char *badblocks = NULL, *ecc = NULL;
+	u64 size = 0;
+	int ret;
+
+	if (!dev->device_node)
+		return -ENODEV;
+
+	priv = xzalloc(sizeof(*priv));
+	priv->dev = dev;
+
+	ret = of_property_read_u32(dev->device_node, "barebox,fd", &priv->fd);
+	if (ret)
+		goto err;
+
+	ret = of_property_read_string(dev->device_node, "barebox,filename",
+				      &priv->filename);
+	if (ret)
+		goto err;
+
+	of_property_read_u64(dev->device_node, "barebox,size", &size);
+	of_property_read_string(dev->device_node, "barebox,options", &options);
+
+	/* defaults: 128MiB of 2KiB pages, latencies of a typical SLC NAND */
+	priv->pagesize = 2048;
+	priv->oobsize = 64;
+	priv->pages_per_block = 64;
+	priv->blocks = 1024;
+	priv->t_r = 25;
+	priv->t_rcbsy = 3;
+	priv->readcache = 1;
+	priv->t_prog = 200;
+	priv->t_bers = 1500;
+
+	ret = sandbox_nand_parse_options(priv, options, &badblocks, &ecc);
+	if (ret)
+		goto err;
+
+	if (!is_power_of_2(priv->pagesize) || priv->pagesize < 512 ||
+	    !priv->oobsize || !is_power_of_2(priv->pages_per_block) ||
+	    !priv->blocks) {
+		dev_err(dev, "invalid geometry\n");
+		ret = -EINVAL;
+		goto err;
+	}
+
+	priv->reg = xmalloc(sandbox_nand_rawsize(priv));
+	priv->datareg = xmalloc(sandbox_nand_rawsize(priv));
+	priv->cache_page = -1;
+	priv->bad = xzalloc(BITS_TO_LONGS(priv->blocks) * sizeof(long));
+
+	ret = sandbox_nand_init_flash(priv, size, badblocks);
+	if (ret)
+		goto err;
+
+	sandbox_nand_init_onfi(priv);
+
+	mtd = &priv->mtd;
+	chip = &priv->chip;
+
+	mtd->priv = chip;
+	mtd->parent = dev;
+	chip->priv = priv;
+	chip->cmd_ctrl = sandbox_nand_cmd_ctrl;
+	chip->read_byte = sandbox_nand_read_byte;
+	chip->read_buf = sandbox_nand_read_buf;
+	chip->write_buf = sandbox_nand_write_buf;
+	chip->dev_ready = sandbox_nand_dev_ready;
+	chip->chip_delay = 0;
+
+	chip->ecc.mode = NAND_ECC_SOFT;
+	if (ecc && !strncmp(ecc, "bch", 3)) {
+		if (!IS_ENABLED(CONFIG_NAND_ECC_BCH)) {
+			dev_err(dev, "BCH ecc support not enabled\n");
+			ret = -ENOSYS;
+			goto err;
+		}
+
+		chip->ecc.mode = NAND_ECC_SOFT_BCH;
+		chip->ecc.size = 512;
+		chip->ecc.strength = ecc[3] ? simple_strtoul(ecc + 3, NULL, 0) : 4;
+		chip->ecc.bytes = DIV_ROUND_UP(13 * chip->ecc.strength, 8);
+	}
+
+	dev->priv = priv;
+	dev->info = sandbox_nand_info;
+
+	ret = nand_scan(mtd, 1);
+	if (ret)
+		goto err;
+
+	free(badblocks);
+	free(ecc);
+
+	ret = add_mtd_nand_device(mtd, "nand");
+	if (ret)
+		return ret;
+
+	mtddev = &mtd->class_dev;
+	dev_add_param_int(mtddev, "tR", NULL, NULL, &priv->t_r, "%d", NULL);
+	dev_add_param_int(mtddev, "tRCBSY", NULL, NULL, &priv->t_rcbsy, "%d",
+			  NULL);
+	dev_add_param_int(mtddev, "tPROG", NULL, NULL, &priv->t_prog, "%d", NULL);
+	dev_add_param_int(mtddev, "tBERS", NULL, NULL, &priv->t_bers, "%d", NULL);
+	dev_add_param_bool(mtddev, "delay", NULL, NULL, &priv->delay, NULL);
+	dev_add_param_int(mtddev, "bitflips", NULL, NULL, &priv->bitflips, "%d",
+			  NULL);
+	dev_add_param_int(mtddev, "reads", NULL, NULL, &priv->reads, "%d", NULL);
+	dev_add_param_int(mtddev, "programs", NULL, NULL, &priv->programs, "%d",
+			  NULL);
+	dev_add_param_int(mtddev, "erases", NULL, NULL, &priv->erases, "%d",
+			  NULL);
+	dev_add_param_int(mtddev, "time_us", NULL, NULL, &priv->time_us, "%d",
+			  NULL);
+
+	return 0;
+err:
+	free(badblocks);
+	free(ecc);
+	free(priv->reg);
+	free(priv->datareg);
+	free(priv->bad);
+	free(priv);
+
+	return ret;
+}
+
+static __maybe_unused struct of_device_id sandbox_nand_dt_ids[] = {
+	{
+		.compatible = "barebox,sandbox-nand",
+	}, {
+		/* sentinel */
+	}
+};
+
+static struct driver_d sandbox_nand_driver = {
+	.name  = "sandbox-nand",
+	.probe = sandbox_nand_probe,
+	.of_compatible = DRV_OF_COMPAT(sandbox_nand_dt_ids),
+};
+device_platform_driver(sandbox_nand_driver);
@@ -81,6 +81,7 @@
 #include <linux/err.h>
 #include <linux/math64.h>
 #include <stdlib.h>
+#include <clock.h>
 #include "ubi.h"
 
 static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
@@ -819,6 +820,8 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi_io_read_hdrs(ubi, pnum);
+
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
@@ -1225,13 +1228,30 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!vidh)
 		goto out_ech;
 
+	err = 0;
+
+	/*
+	 * Read both headers of a PEB at once. This is only an optimization,
+	 * so just go on with separate reads if there is no memory for it.
+	 */
+	ubi->hdrs_len = ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize;
+	ubi->hdrs_buf = kmalloc(ubi->hdrs_len, GFP_KERNEL);
+
 	for (pnum = start; pnum < ubi->peb_count; pnum++) {
 		dbg_gen("process PEB %d", pnum);
 		err = scan_peb(ubi, ai, pnum, NULL, NULL);
 		if (err < 0)
-			goto out_vidh;
+			break;
 	}
 
+	kfree(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
+	ubi->hdrs_len = 0;
+	ubi->hdrs_pnum = -1;
+
+	if (err < 0)
+		goto out_vidh;
+
 	ubi_msg("scanning is finished");
 
 	/* Calculate mean erase counter */
@@ -1358,6 +1378,21 @@ static struct ubi_attach_info *alloc_ai(const char *slab_name)
 	return ai;
 }
 
+/**
+ * attach_phase_done - account the time spent in an attach phase.
+ * @ubi: UBI device description object
+ * @phase: the phase which is finished
+ * @start: start time of @phase, updated to the start of the next phase
+ */
+static void attach_phase_done(struct ubi_device *ubi,
+			      enum ubi_attach_phase phase, uint64_t *start)
+{
+	uint64_t now = get_time_ns();
+
+	ubi->attach_time[phase] = div_u64(now - *start, 1000);
+	*start = now;
+}
+
 /**
  * ubi_attach - attach an MTD device.
  * @ubi: UBI device descriptor
@@ -1370,6 +1405,7 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 {
 	int err;
 	struct ubi_attach_info *ai;
+	uint64_t start = get_time_ns();
 
 	ai = alloc_ai("ubi_aeb_slab_cache");
 	if (!ai)
@@ -1405,6 +1441,8 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	if (err)
 		goto out_ai;
 
+	attach_phase_done(ubi, UBI_ATTACH_SCAN, &start);
+
 	ubi->bad_peb_count = ai->bad_peb_count;
 	ubi->good_peb_count = ubi->peb_count - ubi->bad_peb_count;
 	ubi->corr_peb_count = ai->corr_peb_count;
@@ -1416,14 +1454,26 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	if (err)
 		goto out_ai;
 
+	attach_phase_done(ubi, UBI_ATTACH_VTBL, &start);
+
 	err = ubi_wl_init(ubi, ai);
 	if (err)
 		goto out_vtbl;
 
+	attach_phase_done(ubi, UBI_ATTACH_WL, &start);
+
 	err = ubi_eba_init(ubi, ai);
 	if (err)
 		goto out_wl;
 
+	attach_phase_done(ubi, UBI_ATTACH_EBA, &start);
+
+	ubi_msg("attach time: scan %u us, volume table %u us, wear-leveling %u us, EBA %u us",
+		ubi->attach_time[UBI_ATTACH_SCAN],
+		ubi->attach_time[UBI_ATTACH_VTBL],
+		ubi->attach_time[UBI_ATTACH_WL],
+		ubi->attach_time[UBI_ATTACH_EBA]);
+
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	if (ubi->fm && ubi_dbg_chk_gen(ubi)) {
 		struct ubi_attach_info *scan_ai;
@@ -29,6 +29,9 @@
 #include <linux/stringify.h>
 #include <linux/stat.h>
 #include <linux/log2.h>
+#include <init.h>
+#include <globalvar.h>
+#include <magicvar.h>
 #include "ubi.h"
 
 /* Maximum length of the 'mtd=' parameter */
@@ -53,7 +56,7 @@ struct mtd_dev_param {
 /* MTD devices specification parameters */
 #ifdef CONFIG_MTD_UBI_FASTMAP
 /* UBI module parameter to enable fastmap automatically on non-fastmap images */
-static bool fm_autoconvert = 1;
+static int fm_autoconvert = 1;
 #endif
 
 /* All UBI devices in system */
@@ -617,6 +620,12 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 		goto out_free;
 	}
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	/* Without a fastmap the next attach has to scan the whole device */
+	if (!ubi->fm)
+		ubi->fm_dirty = 1;
+#endif
+
 	if (ubi->autoresize_vol_id != -1) {
 		err = autoresize(ubi, ubi->autoresize_vol_id);
 		if (err)
@@ -657,6 +666,14 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 	dev_add_param_int_ro(&ubi->dev, "mean_erase_counter", ubi->mean_ec, "%d");
 	dev_add_param_int_ro(&ubi->dev, "available_pebs", ubi->avail_pebs, "%d");
 	dev_add_param_int_ro(&ubi->dev, "reserved_pebs", ubi->rsvd_pebs, "%d");
+	dev_add_param_int_ro(&ubi->dev, "attach_scan_us",
+			     ubi->attach_time[UBI_ATTACH_SCAN], "%d");
+	dev_add_param_int_ro(&ubi->dev, "attach_vtbl_us",
+			     ubi->attach_time[UBI_ATTACH_VTBL], "%d");
+	dev_add_param_int_ro(&ubi->dev, "attach_wl_us",
+			     ubi->attach_time[UBI_ATTACH_WL], "%d");
+	dev_add_param_int_ro(&ubi->dev, "attach_eba_us",
+			     ubi->attach_time[UBI_ATTACH_EBA], "%d");
 
 	/*
 	 * The below lock makes sure we do not race with 'ubi_thread()' which
@@ -717,7 +734,8 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	/* If we don't write a new fastmap at detach time we lose all
 	 * EC updates that have been made since the last written fastmap. */
-	ubi_update_fastmap(ubi);
+	if (ubi->fm_dirty)
+		ubi_update_fastmap(ubi);
 	ubi_free_fastmap(ubi);
 #endif
 
@@ -733,3 +751,35 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 
 	return 0;
 }
+
+#ifdef CONFIG_MTD_UBI_FASTMAP
+/*
+ * Devices are usually not detached before starting an operating system, so
+ * write the fastmap of changed devices here. This way the kernel and the next
+ * barebox start can attach from the fastmap instead of scanning.
+ */
+static void ubi_fastmap_shutdown(void)
+{
+	struct ubi_device *ubi;
+	int i;
+
+	for (i = 0; i < UBI_MAX_DEVICES; i++) {
+		ubi = ubi_devices[i];
+		if (!ubi || !ubi->fm_dirty)
+			continue;
+
+		if (ubi_update_fastmap(ubi))
+			ubi_err("Unable to update fastmap of ubi%d!", i);
+	}
+}
+predevshutdown_exitcall(ubi_fastmap_shutdown);
+
+static int ubi_fastmap_init(void)
+{
+	return globalvar_add_simple_bool("ubi.fm_autoconvert", &fm_autoconvert);
+}
+device_initcall(ubi_fastmap_init);
+
+BAREBOX_MAGICVAR_NAMED(global_ubi_fm_autoconvert, global.ubi.fm_autoconvert,
+		"Add a fastmap to UBI devices attached without one");
+#endif
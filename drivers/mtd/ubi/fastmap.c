@@ -1523,6 +1523,8 @@ int ubi_update_fastmap(struct ubi_device *ubi)
 	if (ret)
 		goto err;
 
+	ubi->fm_dirty = 0;
+
 out_unlock:
 	kfree(old_fm);
 	return ret;
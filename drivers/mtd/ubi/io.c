@@ -134,6 +134,11 @@ int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
 	if (err)
 		return err;
 
+	if (pnum == ubi->hdrs_pnum && offset + len <= ubi->hdrs_len) {
+		memcpy(buf, ubi->hdrs_buf + offset, len);
+		return 0;
+	}
+
 	/*
 	 * Deliberately corrupt the buffer to improve robustness. Indeed, if we
 	 * do not do this, the following may happen:
@@ -238,6 +243,10 @@ int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 	ubi_assert(offset % ubi->hdrs_min_io_size == 0);
 	ubi_assert(len > 0 && len % ubi->hdrs_min_io_size == 0);
 
+	if (pnum == ubi->hdrs_pnum)
+		ubi->hdrs_pnum = -1;
+	ubi->fm_dirty = 1;
+
 	if (ubi->ro_mode) {
 		ubi_err("read-only mode");
 		return -EROFS;
@@ -547,6 +556,10 @@ int ubi_io_sync_erase(struct ubi_device *ubi, int pnum, int torture)
 
 	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
 
+	if (pnum == ubi->hdrs_pnum)
+		ubi->hdrs_pnum = -1;
+	ubi->fm_dirty = 1;
+
 	err = self_check_not_bad(ubi, pnum);
 	if (err != 0)
 		return err;
@@ -683,6 +696,35 @@ bad:
 	return 1;
 }
 
+/**
+ * ubi_io_read_hdrs - read both headers of a physical eraseblock at once.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock to read from
+ *
+ * This function is used while scanning. It reads the EC and the VID header of
+ * physical eraseblock @pnum with a single MTD read, which the NAND layer can
+ * serve with back to back page reads, instead of two separate small reads.
+ * The following 'ubi_io_read_ec_hdr()' and 'ubi_io_read_vid_hdr()' calls for
+ * @pnum are then served from @ubi->hdrs_buf. The buffer is only used if the
+ * read was clean: in case of bit-flips or ECC errors the headers are read
+ * separately again so that the errors are attributed to the right header.
+ */
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum)
+{
+	size_t read;
+	int err;
+
+	ubi->hdrs_pnum = -1;
+
+	if (!ubi->hdrs_buf)
+		return;
+
+	err = mtd_read(ubi->mtd, (loff_t)pnum * ubi->peb_size, ubi->hdrs_len,
+		       &read, ubi->hdrs_buf);
+	if (!err && read == ubi->hdrs_len)
+		ubi->hdrs_pnum = pnum;
+}
+
 /**
  * ubi_io_read_ec_hdr - read and check an erase counter header.
  * @ubi: UBI device description object
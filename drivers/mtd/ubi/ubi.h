@@ -137,6 +137,22 @@ enum {
 	UBI_BAD_FASTMAP,
 };
 
+/*
+ * Phases of attaching an UBI device, used to index @attach_time
+ *
+ * UBI_ATTACH_SCAN: scanning the PEB headers or reading the fastmap
+ * UBI_ATTACH_VTBL: reading the volume table
+ * UBI_ATTACH_WL: initializing the wear-leveling sub-system
+ * UBI_ATTACH_EBA: initializing the EBA sub-system
+ */
+enum ubi_attach_phase {
+	UBI_ATTACH_SCAN,
+	UBI_ATTACH_VTBL,
+	UBI_ATTACH_WL,
+	UBI_ATTACH_EBA,
+	UBI_ATTACH_PHASES,
+};
+
 /**
  * struct ubi_wl_entry - wear-leveling entry.
  * @u.rb: link in the corresponding (free/used) RB-tree
@@ -405,6 +421,8 @@ struct ubi_debug_info {
  * @alc_mutex: serializes "atomic LEB change" operations
  *
  * @fm_disabled: non-zero if fastmap is disabled (default)
+ * @fm_dirty: non-zero if the flash was changed since the last fastmap was
+ *            written or if there is no fastmap at all
  * @fm: in-memory data structure of the currently used fastmap
  * @fm_pool: in-memory data structure of the fastmap pool
  * @fm_wl_pool: in-memory data structure of the fastmap pool used by the WL
@@ -474,6 +492,13 @@ struct ubi_debug_info {
  * @buf_mutex: protects @peb_buf
  * @ckvol_mutex: serializes static volume checking when opening
  *
+ * @hdrs_buf: both headers of the PEB being scanned (see 'ubi_io_read_hdrs()')
+ * @hdrs_len: size of @hdrs_buf
+ * @hdrs_pnum: PEB whose headers are in @hdrs_buf, %-1 if none
+ *
+ * @attach_time: time spent in the phases of 'ubi_attach()' in microseconds,
+ *               see &enum ubi_attach_phase
+ *
  * @dbg: debugging information for this UBI device
  */
 struct ubi_device {
@@ -507,6 +532,7 @@ struct ubi_device {
 
 	/* Fastmap stuff */
 	int fm_disabled;
+	int fm_dirty;
 	struct ubi_fastmap_layout *fm;
 	struct ubi_fm_pool fm_pool;
 	struct ubi_fm_pool fm_wl_pool;
@@ -558,6 +584,12 @@ struct ubi_device {
 
 	void *peb_buf;
 
+	void *hdrs_buf;
+	int hdrs_len;
+	int hdrs_pnum;
+
+	unsigned int attach_time[UBI_ATTACH_PHASES];
+
 	struct ubi_debug_info dbg;
 };
 
@@ -807,6 +839,7 @@ int ubi_io_write_ec_hdr(struct ubi_device *ubi, int pnum,
 			struct ubi_ec_hdr *ec_hdr);
 int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 			struct ubi_vid_hdr *vid_hdr, int verbose);
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum);
 int ubi_io_write_vid_hdr(struct ubi_device *ubi, int pnum,
 			 struct ubi_vid_hdr *vid_hdr);
 
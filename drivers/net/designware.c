@@ -45,7 +45,7 @@ struct dw_eth_dev {
 	struct dmamacdescr *rx_mac_descrtable;
 
 	u8 *txbuffs;
-	u8 *rxbuffs;
+	void *rxbuffs[CONFIG_RX_DESCR_NUM];
 
 	struct eth_mac_regs *mac_regs_p;
 	struct eth_dma_regs *dma_regs_p;
@@ -181,13 +181,12 @@ static void rx_descs_init(struct eth_device *dev)
 	struct dw_eth_dev *priv = dev->priv;
 	struct eth_dma_regs *dma_p = priv->dma_regs_p;
 	struct dmamacdescr *desc_table_p = &priv->rx_mac_descrtable[0];
-	char *rxbuffs = &priv->rxbuffs[0];
 	struct dmamacdescr *desc_p;
 	u32 idx;
 
 	for (idx = 0; idx < CONFIG_RX_DESCR_NUM; idx++) {
 		desc_p = &desc_table_p[idx];
-		desc_p->dmamac_addr = &rxbuffs[idx * CONFIG_ETH_BUFSIZE];
+		desc_p->dmamac_addr = priv->rxbuffs[idx];
 		desc_p->dmamac_next = &desc_table_p[idx + 1];
 
 		desc_p->dmamac_cntl = MAC_MAX_FRAME_SZ;
@@ -341,6 +340,7 @@ static int dwc_ether_rx(struct eth_device *dev)
 
 	u32 status = desc_p->txrx_status;
 	int length = 0;
+	void *buf;
 
 	/* Check  if the owner is the CPU */
 	if (status & DESC_RXSTS_OWNBYDMA)
@@ -355,9 +355,17 @@ static int dwc_ether_rx(struct eth_device *dev)
 	 */
 	dma_sync_single_for_cpu((unsigned long)desc_p->dmamac_addr, length,
 				DMA_FROM_DEVICE);
-	net_receive(dev, desc_p->dmamac_addr, length);
-	dma_sync_single_for_device((unsigned long)desc_p->dmamac_addr, length,
-				   DMA_FROM_DEVICE);
+	buf = net_receive_buf(dev, desc_p->dmamac_addr, length);
+	if (buf != desc_p->dmamac_addr) {
+		/* the stack kept the buffer, continue with a fresh one */
+		priv->rxbuffs[desc_num] = buf;
+		desc_p->dmamac_addr = buf;
+		dma_sync_single_for_device((unsigned long)buf,
+					   CONFIG_ETH_BUFSIZE, DMA_FROM_DEVICE);
+	} else {
+		dma_sync_single_for_device((unsigned long)buf, length,
+					   DMA_FROM_DEVICE);
+	}
 
 	desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
 
@@ -428,6 +436,7 @@ static int dwc_ether_probe(struct device_d *dev)
 	struct dwc_ether_platform_data *pdata = dev->platform_data;
 	int ret;
 	struct dw_eth_drvdata *drvdata;
+	int i;
 
 	priv = xzalloc(sizeof(struct dw_eth_dev));
 
@@ -461,7 +470,8 @@ static int dwc_ether_probe(struct device_d *dev)
 		CONFIG_RX_DESCR_NUM * sizeof(struct dmamacdescr),
 		DMA_ADDRESS_BROKEN);
 	priv->txbuffs = dma_alloc(TX_TOTAL_BUFSIZE);
-	priv->rxbuffs = dma_alloc(RX_TOTAL_BUFSIZE);
+	for (i = 0; i < CONFIG_RX_DESCR_NUM; i++)
+		priv->rxbuffs[i] = net_rx_alloc_buf();
 
 	edev = &priv->netdev;
 	miibus = &priv->miibus;
@@ -530,6 +530,7 @@ static int fec_recv(struct eth_device *dev)
 	int frame_length, len = 0;
 	struct fec_frame *frame;
 	uint16_t bd_status;
+	void *buf;
 
 	/*
 	 * Check if any critical events have happened
@@ -570,11 +571,6 @@ static int fec_recv(struct eth_device *dev)
 		if ((bd_status & FEC_RBD_LAST) && !(bd_status & FEC_RBD_ERR) &&
 			((readw(&rbd->data_length) - 4) > 14)) {
 
-			if (fec_is_imx28(fec))
-				imx28_fix_endianess_rd(
-					phys_to_virt(readl(&rbd->data_pointer)),
-					(readw(&rbd->data_length) + 3) >> 2);
-
 			/*
 			 * Get buffer address and size
 			 */
@@ -582,10 +578,23 @@ static int fec_recv(struct eth_device *dev)
 			frame_length = readw(&rbd->data_length) - 4;
 			dma_sync_single_for_cpu((unsigned long)frame->data,
 						frame_length, DMA_FROM_DEVICE);
-			net_receive(dev, frame->data, frame_length);
-			dma_sync_single_for_device((unsigned long)frame->data,
-						   frame_length, DMA_FROM_DEVICE);
+
+			if (fec_is_imx28(fec))
+				imx28_fix_endianess_rd((u32 *)frame->data,
+					(readw(&rbd->data_length) + 3) >> 2);
+
+			/*
+			 * The stack may keep the buffer, in which case we
+			 * get a fresh one for this descriptor.
+			 */
 			len = frame_length;
+			buf = net_receive_buf(dev, frame->data, frame_length);
+			if (buf != frame->data) {
+				writel(virt_to_phys(buf), &rbd->data_pointer);
+				frame_length = FEC_MAX_PKT_SIZE;
+			}
+			dma_sync_single_for_device((unsigned long)buf,
+						   frame_length, DMA_FROM_DEVICE);
 		} else {
 			if (bd_status & FEC_RBD_ERR) {
 				dev_warn(&dev->dev, "error frame: 0x%p 0x%08x\n", rbd, bd_status);
@@ -608,14 +617,17 @@ static int fec_alloc_receive_packets(struct fec_priv *fec, int count, int size)
 	void *p;
 	int i;
 
-	/* reserve data memory and consider alignment */
-	p = dma_alloc_coherent(size * count, DMA_ADDRESS_BROKEN);
-	if (!p)
-		return -ENOMEM;
+	/*
+	 * Take the buffers from the network receive pool so that they
+	 * can be handed up the stack without copying.
+	 */
+	BUILD_BUG_ON(FEC_MAX_PKT_SIZE > NET_RX_BUF_SIZE);
 
 	for (i = 0; i < count; i++) {
+		p = net_rx_alloc_buf();
+		dma_sync_single_for_device((unsigned long)p, size,
+					   DMA_FROM_DEVICE);
 		writel(virt_to_phys(p), &fec->rbd_base[i].data_pointer);
-		p += size;
 	}
 
 	return 0;
@@ -67,6 +67,7 @@ struct macb_device {
 	unsigned int		tx_tail;
 
 	void			*rx_buffer;
+	void			**rx_buffers;
 	void			*tx_buffer;
 	struct macb_dma_desc	*rx_ring;
 	struct macb_dma_desc	*tx_ring;
@@ -173,7 +174,7 @@ static void reclaim_rx_buffers(struct macb_device *macb,
 static int gem_recv(struct eth_device *edev)
 {
 	struct macb_device *macb = edev->priv;
-	void *buffer;
+	void *buffer, *buf;
 	int length;
 	u32 status;
 
@@ -187,11 +188,19 @@ static int gem_recv(struct eth_device *edev)
 		barrier();
 		status = macb->rx_ring[macb->rx_tail].ctrl;
 		length = MACB_BFEXT(RX_FRMLEN, status);
-		buffer = macb->rx_buffer + macb->rx_buffer_size * macb->rx_tail;
+		buffer = macb->rx_buffers[macb->rx_tail];
 		dma_sync_single_for_cpu((unsigned long)buffer, length,
 					DMA_FROM_DEVICE);
-		net_receive(edev, buffer, length);
-		dma_sync_single_for_device((unsigned long)buffer, length,
+		buf = net_receive_buf(edev, buffer, length);
+		if (buf != buffer) {
+			/* the stack kept the buffer, continue with a fresh one */
+			macb->rx_buffers[macb->rx_tail] = buf;
+			macb->rx_ring[macb->rx_tail].addr = (ulong)buf |
+				(macb->rx_ring[macb->rx_tail].addr &
+				 (MACB_BIT(RX_WRAP) | MACB_BIT(RX_USED)));
+			length = macb->rx_buffer_size;
+		}
+		dma_sync_single_for_device((unsigned long)buf, length,
 					   DMA_FROM_DEVICE);
 		macb->rx_ring[macb->rx_tail].addr &= ~MACB_BIT(RX_USED);
 		barrier();
@@ -331,6 +340,8 @@ static void macb_init(struct macb_device *macb)
 	/* initialize DMA descriptors */
 	paddr = (ulong)macb->rx_buffer;
 	for (i = 0; i < macb->rx_ring_size; i++) {
+		if (macb->rx_buffers)
+			paddr = (ulong)macb->rx_buffers[i];
 		macb->rx_ring[i].addr = paddr;
 		macb->rx_ring[i].ctrl = 0;
 		paddr += macb->rx_buffer_size;
@@ -588,6 +599,8 @@ static void macb_reset_hw(struct macb_device *bp)
 
 static void macb_init_rx_buffer_size(struct macb_device *bp, size_t size)
 {
+	int i;
+
 	if (!macb_is_gem(bp)) {
 		bp->rx_buffer_size = MACB_RX_BUFFER_SIZE;
 		bp->rx_ring_size = roundup(RX_NB_PACKET * PKTSIZE / MACB_RX_BUFFER_SIZE, 2);
@@ -602,8 +615,18 @@ static void macb_init_rx_buffer_size(struct macb_device *bp, size_t size)
 			bp->rx_buffer_size =
 				roundup(bp->rx_buffer_size, RX_BUFFER_MULTIPLE);
 		}
-		bp->rx_buffer = dma_alloc_coherent(bp->rx_buffer_size * bp->rx_ring_size,
-						   DMA_ADDRESS_BROKEN);
+
+		/*
+		 * Each frame gets a buffer of its own from the network
+		 * receive pool so that it can be handed up the stack.
+		 */
+		bp->rx_buffers = xzalloc(bp->rx_ring_size * sizeof(void *));
+		for (i = 0; i < bp->rx_ring_size; i++) {
+			bp->rx_buffers[i] = net_rx_alloc_buf();
+			dma_sync_single_for_device((unsigned long)bp->rx_buffers[i],
+						   bp->rx_buffer_size,
+						   DMA_FROM_DEVICE);
+		}
 	}
 
 	dev_dbg(bp->dev, "[%d] rx_buffer_size [%d]\n",
@@ -673,8 +696,10 @@ static int macb_probe(struct device_d *dev)
 		edev->recv = macb_recv;
 
 	macb_init_rx_buffer_size(macb, PKTSIZE);
-	macb->rx_buffer = dma_alloc_coherent(macb->rx_buffer_size * macb->rx_ring_size,
-					     DMA_ADDRESS_BROKEN);
+	if (!macb->rx_buffers)
+		macb->rx_buffer = dma_alloc_coherent(macb->rx_buffer_size *
+						     macb->rx_ring_size,
+						     DMA_ADDRESS_BROKEN);
 	macb->rx_ring = dma_alloc_coherent(RX_RING_BYTES(macb), DMA_ADDRESS_BROKEN);
 	macb->tx_ring = dma_alloc_coherent(TX_RING_BYTES, DMA_ADDRESS_BROKEN);
 
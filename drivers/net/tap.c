@@ -27,6 +27,7 @@
 struct tap_priv {
 	int fd;
 	char *name;
+	void *rxbuf;
 };
 
 int tap_eth_send (struct eth_device *edev, void *packet, int length)
@@ -42,10 +43,10 @@ int tap_eth_rx (struct eth_device *edev)
 	struct tap_priv *priv = edev->priv;
 	int length;
 
-	length = linux_read_nonblock(priv->fd, NetRxPackets[0], PKTSIZE);
+	length = linux_read_nonblock(priv->fd, priv->rxbuf, PKTSIZE);
 
 	if (length > 0)
-		net_receive(edev, NetRxPackets[0], length);
+		priv->rxbuf = net_receive_buf(edev, priv->rxbuf, length);
 
 	return 0;
 }
@@ -77,7 +78,7 @@ int tap_probe(struct device_d *dev)
 	int ret = 0;
 
 	priv = xzalloc(sizeof(struct tap_priv));
-	priv->name = "barebox";
+	priv->name = xstrdup("barebox");
 
 	priv->fd = tap_alloc(priv->name);
 	if (priv->fd < 0) {
@@ -85,6 +86,8 @@ int tap_probe(struct device_d *dev)
 		goto out;
 	}
 
+	priv->rxbuf = net_rx_alloc_buf();
+
 	edev = xzalloc(sizeof(struct eth_device));
 	edev->priv = priv;
 	edev->parent = dev;
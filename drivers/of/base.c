@@ -27,6 +27,7 @@
 #include <linux/sizes.h>
 #include <of_graph.h>
 #include <linux/ctype.h>
+#include <linux/hash.h>
 #include <linux/amba/bus.h>
 #include <linux/err.h>
 
@@ -265,6 +266,40 @@ struct device_node *of_find_node_by_alias(struct device_node *root, const char *
 }
 EXPORT_SYMBOL_GPL(of_find_node_by_alias);
 
+/*
+ * All nodes with a phandle, of all trees, are hashed by their phandle so
+ * that resolving a phandle does not need to walk the whole tree. Lookups
+ * filter the chain by the root node of the tree they are searching in.
+ */
+#define OF_PHANDLE_HASH_BITS	8
+
+static struct hlist_head of_phandle_hash[1 << OF_PHANDLE_HASH_BITS];
+static unsigned int of_phandle_hits, of_phandle_misses, of_phandle_walks;
+
+static struct hlist_head *of_phandle_bucket(phandle phandle)
+{
+	return &of_phandle_hash[hash_32(phandle, OF_PHANDLE_HASH_BITS)];
+}
+
+/**
+ * of_node_set_phandle - set the phandle of a node
+ * @node:    the node
+ * @phandle: the new phandle, 0 to remove it
+ *
+ * This only updates the phandle used for lookups, not the "phandle"
+ * property of the node.
+ */
+void of_node_set_phandle(struct device_node *node, phandle phandle)
+{
+	hlist_del_init(&node->phandle_hash);
+
+	node->phandle = phandle;
+
+	if (phandle)
+		hlist_add_head(&node->phandle_hash, of_phandle_bucket(phandle));
+}
+EXPORT_SYMBOL(of_node_set_phandle);
+
 /*
  * of_find_node_by_phandle_from - Find a node given a phandle from given
  * root node.
@@ -276,6 +311,7 @@ struct device_node *of_find_node_by_phandle_from(phandle phandle,
 		struct device_node *root)
 {
 	struct device_node *node;
+	struct hlist_node *n;
 
 	if (!root)
 		root = root_node;
@@ -283,6 +319,23 @@ struct device_node *of_find_node_by_phandle_from(phandle phandle,
 	if (!root)
 		return NULL;
 
+	if (!root->parent) {
+		hlist_for_each_entry(node, n, of_phandle_bucket(phandle),
+				phandle_hash) {
+			if (node->phandle == phandle && node != root &&
+					of_find_root_node(node) == root) {
+				of_phandle_hits++;
+				return node;
+			}
+		}
+
+		of_phandle_misses++;
+		return NULL;
+	}
+
+	/* searching from an inner node, keep the tree order semantics */
+	of_phandle_walks++;
+
 	of_tree_for_each_node_from(node, root)
 		if (node->phandle == phandle)
 			return node;
@@ -291,6 +344,15 @@ struct device_node *of_find_node_by_phandle_from(phandle phandle,
 }
 EXPORT_SYMBOL(of_find_node_by_phandle_from);
 
+static int of_phandle_report(void)
+{
+	pr_debug("of: phandle lookups: %u hits, %u misses, %u tree walks\n",
+			of_phandle_hits, of_phandle_misses, of_phandle_walks);
+
+	return 0;
+}
+late_initcall(of_phandle_report);
+
 /*
  * of_find_node_by_phandle - Find a node given a phandle
  * @handle:    phandle of the node to find
@@ -347,7 +409,7 @@ phandle of_node_create_phandle(struct device_node *node)
 
 	p = of_get_tree_max_phandle(root) + 1;
 
-	node->phandle = p;
+	of_node_set_phandle(node, p);
 
 	p = cpu_to_be32(p);
 
@@ -588,6 +650,181 @@ struct device_node *of_find_matching_node_and_match(struct device_node *from,
 }
 EXPORT_SYMBOL(of_find_matching_node_and_match);
 
+/*
+ * Index of the compatible strings of all registered drivers and of the
+ * nodes of all registered devices. It lets register_device() and
+ * register_driver() find the drivers a device can match and the devices
+ * a driver can match with a hash lookup per compatible, instead of
+ * matching every device against every driver.
+ */
+struct of_compat_entry {
+	struct hlist_node hash;
+	const char *compatible;
+	struct driver_d *drv;		/* either a driver ... */
+	struct device_d *dev;		/* ... or a device */
+};
+
+#define OF_COMPAT_HASH_BITS	8
+
+static struct hlist_head of_compat_hash[1 << OF_COMPAT_HASH_BITS];
+
+/* compatibles are compared case insensitive, see of_compat_cmp() */
+static struct hlist_head *of_compat_bucket(const char *compatible)
+{
+	u32 h = 0;
+
+	while (*compatible)
+		h = h * 31 + tolower(*compatible++);
+
+	return &of_compat_hash[hash_32(h, OF_COMPAT_HASH_BITS)];
+}
+
+static void of_compat_index_add(const char *compatible, struct driver_d *drv,
+		struct device_d *dev)
+{
+	struct of_compat_entry *e = xzalloc(sizeof(*e));
+
+	e->compatible = compatible;
+	e->drv = drv;
+	e->dev = dev;
+	hlist_add_head(&e->hash, of_compat_bucket(compatible));
+}
+
+/**
+ * of_driver_index_add - add the match table of a driver to the index
+ * @drv: the driver, must have an of_compatible table
+ *
+ * Called by register_driver() before the driver is matched against
+ * any device.
+ */
+void of_driver_index_add(struct driver_d *drv)
+{
+	const struct of_device_id *id;
+
+	for (id = drv->of_compatible; id->compatible; id++)
+		of_compat_index_add(id->compatible, drv, NULL);
+}
+
+/**
+ * of_device_index_add - add the compatibles of a device's node to the index
+ * @dev: the device, must have a device_node
+ *
+ * Called by register_device() before the device is matched against any
+ * driver. The compatibles are copied, as the node may be modified later.
+ */
+void of_device_index_add(struct device_d *dev)
+{
+	const char *cp;
+	int cplen, l;
+
+	dev->of_compat_node = dev->device_node;
+
+	cp = of_get_property(dev->device_node, "compatible", &cplen);
+	if (!cp)
+		return;
+
+	while (cplen > 0) {
+		of_compat_index_add(xstrdup(cp), NULL, dev);
+		l = strlen(cp) + 1;
+		cp += l;
+		cplen -= l;
+	}
+}
+
+/**
+ * of_device_index_remove - remove a device from the index
+ * @dev: the device
+ */
+void of_device_index_remove(struct device_d *dev)
+{
+	struct of_compat_entry *e;
+	struct hlist_node *n, *tmp;
+	int i;
+
+	if (!dev->of_compat_node)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(of_compat_hash); i++) {
+		hlist_for_each_entry_safe(e, n, tmp, &of_compat_hash[i], hash) {
+			if (e->dev != dev)
+				continue;
+
+			hlist_del(&e->hash);
+			free((char *)e->compatible);
+			free(e);
+		}
+	}
+
+	dev->of_compat_node = NULL;
+}
+
+static void *of_index_list_add(void **list, int *num, void *p)
+{
+	list = xrealloc(list, (*num + 2) * sizeof(*list));
+	list[(*num)++] = p;
+	list[*num] = NULL;
+
+	return list;
+}
+
+/**
+ * of_driver_index_lookup - find the drivers matching a node
+ * @node: the device node
+ *
+ * Return: a NULL terminated array of the drivers listing one of the
+ * compatibles of @node, to be freed by the caller, or NULL if there are
+ * none.
+ */
+struct driver_d **of_driver_index_lookup(struct device_node *node)
+{
+	struct of_compat_entry *e;
+	struct hlist_node *n;
+	void **list = NULL;
+	const char *cp;
+	int cplen, l, num = 0;
+
+	cp = of_get_property(node, "compatible", &cplen);
+	if (!cp)
+		return NULL;
+
+	while (cplen > 0) {
+		hlist_for_each_entry(e, n, of_compat_bucket(cp), hash)
+			if (e->drv && !of_compat_cmp(cp, e->compatible, 0))
+				list = of_index_list_add(list, &num, e->drv);
+		l = strlen(cp) + 1;
+		cp += l;
+		cplen -= l;
+	}
+
+	return (struct driver_d **)list;
+}
+
+/**
+ * of_device_index_lookup - find the devices matching a driver
+ * @drv: the driver, must have an of_compatible table
+ *
+ * Return: a NULL terminated array of the indexed devices whose node has
+ * one of the compatibles of @drv, to be freed by the caller, or NULL if
+ * there are none.
+ */
+struct device_d **of_device_index_lookup(struct driver_d *drv)
+{
+	const struct of_device_id *id;
+	struct of_compat_entry *e;
+	struct hlist_node *n;
+	void **list = NULL;
+	int num = 0;
+
+	for (id = drv->of_compatible; id->compatible; id++)
+		hlist_for_each_entry(e, n, of_compat_bucket(id->compatible),
+				hash)
+			if (e->dev && !of_compat_cmp(id->compatible,
+						e->compatible, 0))
+				list = of_index_list_add(list, &num, e->dev);
+
+	return (struct device_d **)list;
+}
+
 int of_match(struct device_d *dev, struct driver_d *drv)
 {
 	const struct of_device_id *id;
@@ -974,6 +1211,15 @@ const char *of_prop_next_string(struct property *prop, const char *cur)
 }
 EXPORT_SYMBOL_GPL(of_prop_next_string);
 
+static void __of_delete_property(struct property *pp)
+{
+	list_del(&pp->list);
+
+	of_free(pp->name);
+	of_free(pp->value);
+	of_free_struct(pp);
+}
+
 /**
  * of_property_write_bool - Create/Delete empty (bool) property.
  *
@@ -992,8 +1238,10 @@ int of_property_write_bool(struct device_node *np, const char *propname,
 	struct property *prop = of_find_property(np, propname, NULL);
 
 	if (!value) {
-		if (prop)
-			of_delete_property(prop);
+		if (prop) {
+			__of_delete_property(prop);
+			of_tree_changed(np);
+		}
 		return 0;
 	}
 
@@ -1028,7 +1276,7 @@ int of_property_write_u8_array(struct device_node *np,
 	u8 *val;
 
 	if (prop)
-		of_delete_property(prop);
+		__of_delete_property(prop);
 
 	prop = of_new_property(np, propname, NULL, sizeof(*val) * sz);
 	if (!prop)
@@ -1064,7 +1312,7 @@ int of_property_write_u16_array(struct device_node *np,
 	__be16 *val;
 
 	if (prop)
-		of_delete_property(prop);
+		__of_delete_property(prop);
 
 	prop = of_new_property(np, propname, NULL, sizeof(*val) * sz);
 	if (!prop)
@@ -1100,7 +1348,7 @@ int of_property_write_u32_array(struct device_node *np,
 	__be32 *val;
 
 	if (prop)
-		of_delete_property(prop);
+		__of_delete_property(prop);
 
 	prop = of_new_property(np, propname, NULL, sizeof(*val) * sz);
 	if (!prop)
@@ -1136,7 +1384,7 @@ int of_property_write_u64_array(struct device_node *np,
 	__be32 *val;
 
 	if (prop)
-		of_delete_property(prop);
+		__of_delete_property(prop);
 
 	prop = of_new_property(np, propname, NULL, 2 * sizeof(*val) * sz);
 	if (!prop)
@@ -1508,6 +1756,8 @@ int of_set_root_node(struct device_node *node)
 
 	root_node = node;
 
+	of_tree_changed(NULL);
+
 	of_alias_scan();
 
 	return 0;
@@ -1688,28 +1938,44 @@ void of_print_nodes(struct device_node *node, int indent)
 	printf("};\n");
 }
 
-struct device_node *of_new_node(struct device_node *parent, const char *name)
+/**
+ * of_link_node - add a node to a tree
+ * @node - the node, its name and full_name must already be set
+ * @parent - the parent node, or NULL if @node is a new root node
+ */
+void of_link_node(struct device_node *node, struct device_node *parent)
 {
-	struct device_node *node;
-
-	node = xzalloc(sizeof(*node));
 	node->parent = parent;
-	if (parent)
+	if (parent) {
+		of_tree_changed(parent);
 		list_add_tail(&node->parent_list, &parent->children);
+	}
 
 	INIT_LIST_HEAD(&node->children);
 	INIT_LIST_HEAD(&node->properties);
 
+	if (parent)
+		list_add(&node->list, &parent->list);
+	else
+		INIT_LIST_HEAD(&node->list);
+}
+
+struct device_node *of_new_node(struct device_node *parent, const char *name)
+{
+	struct device_node *node;
+
+	node = xzalloc(sizeof(*node));
+
 	if (parent) {
 		node->name = xstrdup(name);
-		node->full_name = asprintf("%s/%s", node->parent->full_name, name);
-		list_add(&node->list, &parent->list);
+		node->full_name = asprintf("%s/%s", parent->full_name, name);
 	} else {
 		node->name = xstrdup("");
 		node->full_name = xstrdup("");
-		INIT_LIST_HEAD(&node->list);
 	}
 
+	of_link_node(node, parent);
+
 	return node;
 }
 
@@ -1733,6 +1999,8 @@ struct property *of_new_property(struct device_node *node, const char *name,
 
 	list_add_tail(&prop->list, &node->properties);
 
+	of_tree_changed(node);
+
 	return prop;
 }
 
@@ -1741,11 +2009,10 @@ void of_delete_property(struct property *pp)
 	if (!pp)
 		return;
 
-	list_del(&pp->list);
+	/* we don't know which tree @pp belongs to */
+	of_tree_changed(NULL);
 
-	free(pp->name);
-	free(pp->value);
-	free(pp);
+	__of_delete_property(pp);
 }
 
 /**
@@ -1767,7 +2034,13 @@ int of_set_property(struct device_node *np, const char *name, const void *val, i
 	if (!pp && !create)
 		return -ENOENT;
 
-	of_delete_property(pp);
+	if (pp) {
+		/* Leave the tree clean if a fixup sets the value it already has */
+		if (val && pp->length == len && !memcmp(pp->value, val, len))
+			return 0;
+
+		__of_delete_property(pp);
+	}
 
 	pp = of_new_property(np, name, val, len);
 	if (!pp)
@@ -1892,8 +2165,10 @@ void of_delete_node(struct device_node *node)
 	if (!node)
 		return;
 
+	of_tree_changed(node);
+
 	list_for_each_entry_safe(p, pt, &node->properties, list)
-		of_delete_property(p);
+		__of_delete_property(p);
 
 	list_for_each_entry_safe(n, nt, &node->children, parent_list)
 		of_delete_node(n);
@@ -1907,9 +2182,11 @@ void of_delete_node(struct device_node *node)
 	if (dev)
 		dev->device_node = NULL;
 
-	free(node->name);
-	free(node->full_name);
-	free(node);
+	hlist_del_init(&node->phandle_hash);
+
+	of_free(node->name);
+	of_free(node->full_name);
+	of_free_struct(node);
 
 	if (node == root_node)
 		of_set_root_node(NULL);
@@ -1969,12 +2246,16 @@ int of_add_initrd(struct device_node *root, resource_size_t start,
 		struct property *pp;
 
 		pp = of_find_property(chosen, "linux,initrd-start", NULL);
-		if (pp)
-			of_delete_property(pp);
+		if (pp) {
+			__of_delete_property(pp);
+			of_tree_changed(chosen);
+		}
 
 		pp = of_find_property(chosen, "linux,initrd-end", NULL);
-		if (pp)
-			of_delete_property(pp);
+		if (pp) {
+			__of_delete_property(pp);
+			of_tree_changed(chosen);
+		}
 	}
 
 	return 0;
@@ -1995,7 +2276,8 @@ int of_device_enable(struct device_node *node)
 	if (!pp)
 		return 0;
 
-	of_delete_property(pp);
+	__of_delete_property(pp);
+	of_tree_changed(node);
 
 	return 0;
 }
@@ -38,70 +38,100 @@ static inline uint32_t dt_struct_advance(struct fdt_header *f, uint32_t dt, int
 	return dt;
 }
 
-static inline char *dt_string(struct fdt_header *f, char *strstart, uint32_t ofs)
+/*
+ * Trees created by of_unflatten_dtb() live in a single allocation, the
+ * arena. It holds all nodes and properties, the property values, the node
+ * names and one copy of the FDT strings block which all property names
+ * point into. The tree can be modified as usual: properties are always
+ * replaced rather than resized, so changed and new properties and nodes
+ * are allocated from the heap while the arena copies are simply dropped.
+ * The arena itself is freed when its last node or property is deleted.
+ */
+struct of_arena {
+	struct list_head list;
+	void *start;
+	void *end;
+	unsigned int users;
+};
+
+static LIST_HEAD(of_arenas);
+
+static struct of_arena *of_arena_find(const void *ptr)
 {
-	if (ofs > f->size_dt_strings)
-		return NULL;
-	else
-		return strstart + ofs;
+	struct of_arena *arena;
+
+	list_for_each_entry(arena, &of_arenas, list)
+		if (ptr >= arena->start && ptr < arena->end)
+			return arena;
+
+	return NULL;
 }
 
 /**
- * of_unflatten_dtb - unflatten a dtb binary blob
- * @infdt - the fdt blob to unflatten
- *
- * Parse a flat device tree binary blob and return a pointer to the
- * unflattened tree.
+ * of_free - free a name or property value of a device tree
+ * @ptr - the memory to free
  */
-struct device_node *of_unflatten_dtb(const void *infdt)
+void of_free(void *ptr)
 {
-	const void *nodep;	/* property node pointer */
-	uint32_t tag;		/* tag */
-	int  len;		/* length of the property */
-	const struct fdt_property *fdt_prop;
-	const char *pathp, *name;
-	struct device_node *root, *node = NULL;
-	struct property *p;
-	uint32_t dt_struct;
-	const struct fdt_node_header *fnh;
-	void *dt_strings;
-	struct fdt_header f;
-	int ret;
-	unsigned int maxlen;
-	const struct fdt_header *fdt = infdt;
+	if (!of_arena_find(ptr))
+		free(ptr);
+}
 
-	if (fdt->magic != cpu_to_fdt32(FDT_MAGIC)) {
-		pr_err("bad magic: 0x%08x\n", fdt32_to_cpu(fdt->magic));
-		return ERR_PTR(-EINVAL);
-	}
+/**
+ * of_free_struct - free a device tree node or property
+ * @ptr - the node or property to free
+ */
+void of_free_struct(void *ptr)
+{
+	struct of_arena *arena = of_arena_find(ptr);
 
-	if (fdt->version != cpu_to_fdt32(17)) {
-		pr_err("bad dt version: 0x%08x\n", fdt32_to_cpu(fdt->version));
-		return ERR_PTR(-EINVAL);
+	if (!arena) {
+		free(ptr);
+		return;
 	}
 
-	f.totalsize = fdt32_to_cpu(fdt->totalsize);
-	f.off_dt_struct = fdt32_to_cpu(fdt->off_dt_struct);
-	f.size_dt_struct = fdt32_to_cpu(fdt->size_dt_struct);
-	f.off_dt_strings = fdt32_to_cpu(fdt->off_dt_strings);
-	f.size_dt_strings = fdt32_to_cpu(fdt->size_dt_strings);
+	if (--arena->users)
+		return;
 
-	if (f.off_dt_struct + f.size_dt_struct > f.totalsize) {
-		pr_err("unflatten: dt size exceeds total size\n");
-		return ERR_PTR(-ESPIPE);
-	}
+	list_del(&arena->list);
+	free(arena);
+}
 
-	if (f.off_dt_strings + f.size_dt_strings > f.totalsize) {
-		pr_err("unflatten: string size exceeds total size\n");
-		return ERR_PTR(-ESPIPE);
-	}
+#define OF_UNFLATTEN_MAX_DEPTH	64
 
-	dt_struct = f.off_dt_struct;
-	dt_strings = (void *)fdt + f.off_dt_strings;
+/*
+ * State of of_unflatten_pass(). The first pass only validates the blob and
+ * counts, the second one places the tree at the allocation cursors.
+ */
+struct of_unflatten_ctx {
+	unsigned int nodes;
+	unsigned int properties;
+	size_t names;
+	size_t values;
+
+	struct device_node *node_mem;
+	struct property *prop_mem;
+	char *value_mem;
+	char *name_mem;
+	char *strings;
+};
 
-	root = of_new_node(NULL, NULL);
-	if (!root)
-		return ERR_PTR(-ENOMEM);
+static int of_unflatten_pass(const void *infdt, struct fdt_header *f,
+		struct of_unflatten_ctx *ctx, struct device_node **rootp)
+{
+	const struct fdt_header *fdt = infdt;
+	const struct fdt_node_header *fnh;
+	const struct fdt_property *fdt_prop;
+	struct device_node *node = NULL, *parent;
+	struct property *p;
+	unsigned int pathlen[OF_UNFLATTEN_MAX_DEPTH];
+	unsigned int maxlen, nameoff;
+	bool build = ctx->node_mem != NULL;
+	uint32_t dt_struct = f->off_dt_struct;
+	uint32_t tag;
+	const char *name;
+	char *full;
+	int depth = -1, roots = 0, len, plen;
 
 	while (1) {
 		tag = be32_to_cpu(*(uint32_t *)(infdt + dt_struct));
@@ -109,82 +139,220 @@ struct device_node *of_unflatten_dtb(const void *infdt)
 		switch (tag) {
 		case FDT_BEGIN_NODE:
 			fnh = infdt + dt_struct;
-			pathp = name = fnh->name;
-			maxlen = (unsigned long)fdt + f.off_dt_struct +
-				f.size_dt_struct - (unsigned long)name;
+			name = fnh->name;
+			maxlen = (unsigned long)fdt + f->off_dt_struct +
+				f->size_dt_struct - (unsigned long)name;
 
 			len = strnlen(name, maxlen + 1);
-			if (len > maxlen) {
-				ret = -ESPIPE;
-				goto err;
+			if (len > maxlen)
+				return -ESPIPE;
+
+			if (depth < 0 && roots++) {
+				pr_err("unflatten: multiple root nodes\n");
+				return -EINVAL;
 			}
 
-			if (!node)
-				node = root;
-			else
-				node = of_new_node(node, pathp);
+			if (++depth >= OF_UNFLATTEN_MAX_DEPTH) {
+				pr_err("unflatten: nodes nested too deep\n");
+				return -EINVAL;
+			}
 
-			dt_struct = dt_struct_advance(&f, dt_struct,
+			/* the root node is always nameless */
+			plen = depth ? pathlen[depth - 1] : 0;
+			pathlen[depth] = depth ? plen + 1 + len : 0;
+
+			if (!build) {
+				ctx->nodes++;
+				ctx->names += pathlen[depth] + 1;
+			} else {
+				parent = node;
+				node = ctx->node_mem++;
+				full = ctx->name_mem;
+				ctx->name_mem += pathlen[depth] + 1;
+
+				if (parent) {
+					memcpy(full, parent->full_name, plen);
+					full[plen] = '/';
+					memcpy(full + plen + 1, name, len);
+					node->name = full + plen + 1;
+				} else {
+					node->name = full;
+					*rootp = node;
+				}
+				full[pathlen[depth]] = 0;
+				node->full_name = full;
+
+				of_link_node(node, parent);
+			}
+
+			dt_struct = dt_struct_advance(f, dt_struct,
 					sizeof(struct fdt_node_header) + len + 1);
 
 			break;
 
 		case FDT_END_NODE:
-			if (!node) {
+			if (depth < 0) {
 				pr_err("unflatten: too many end nodes\n");
-				ret = -EINVAL;
-				goto err;
+				return -EINVAL;
 			}
 
-			node = node->parent;
+			depth--;
+			if (build)
+				node = node->parent;
 
-			dt_struct = dt_struct_advance(&f, dt_struct, FDT_TAGSIZE);
+			dt_struct = dt_struct_advance(f, dt_struct, FDT_TAGSIZE);
 
 			break;
 
 		case FDT_PROP:
+			if (depth < 0) {
+				pr_err("unflatten: property outside of a node\n");
+				return -EINVAL;
+			}
+
 			fdt_prop = infdt + dt_struct;
 			len = fdt32_to_cpu(fdt_prop->len);
-			nodep = fdt_prop->data;
+			nameoff = fdt32_to_cpu(fdt_prop->nameoff);
+
+			if (len < 0 || nameoff >= f->size_dt_strings)
+				return -ESPIPE;
+
+			dt_struct = dt_struct_advance(f, dt_struct,
+					sizeof(struct fdt_property) + len);
+			if (!dt_struct)
+				return -ESPIPE;
 
-			name = dt_string(&f, dt_strings, fdt32_to_cpu(fdt_prop->nameoff));
-			if (!name) {
-				ret = -ESPIPE;
-				goto err;
+			if (!build) {
+				ctx->properties++;
+				ctx->values += ALIGN(len, 4);
+				break;
 			}
 
-			p = of_new_property(node, name, nodep, len);
-			if (!strcmp(name, "phandle") && len == 4)
-				node->phandle = be32_to_cpup(p->value);
+			p = ctx->prop_mem++;
+			p->name = ctx->strings + nameoff;
+			p->length = len;
+			p->value = ctx->value_mem;
+			memcpy(p->value, fdt_prop->data, len);
+			ctx->value_mem += ALIGN(len, 4);
+			list_add_tail(&p->list, &node->properties);
 
-			dt_struct = dt_struct_advance(&f, dt_struct,
-					sizeof(struct fdt_property) + len);
+			if (!strcmp(p->name, "phandle") && len == 4)
+				of_node_set_phandle(node, be32_to_cpup(p->value));
 
 			break;
 
 		case FDT_NOP:
-			dt_struct = dt_struct_advance(&f, dt_struct, FDT_TAGSIZE);
+			dt_struct = dt_struct_advance(f, dt_struct, FDT_TAGSIZE);
 
 			break;
 
 		case FDT_END:
-			return root;
+			if (!roots) {
+				pr_err("unflatten: no root node\n");
+				return -EINVAL;
+			}
+
+			return 0;
 
 		default:
 			pr_err("unflatten: Unknown tag 0x%08X\n", tag);
-			ret = -EINVAL;
-			goto err;
+			return -EINVAL;
 		}
 
-		if (!dt_struct) {
-			ret = -ESPIPE;
-			goto err;
-		}
+		if (!dt_struct)
+			return -ESPIPE;
+	}
+}
+
+/**
+ * of_unflatten_dtb - unflatten a dtb binary blob
+ * @infdt - the fdt blob to unflatten
+ *
+ * Parse a flat device tree binary blob and return a pointer to the
+ * unflattened tree. The blob is parsed twice: the first pass validates it
+ * and sizes the tree which is then built in a single arena allocation.
+ */
+struct device_node *of_unflatten_dtb(const void *infdt)
+{
+	struct of_unflatten_ctx ctx = {};
+	struct device_node *root = NULL;
+	struct of_arena *arena;
+	struct fdt_header f;
+	size_t size;
+	void *mem;
+	unsigned int i;
+	int ret;
+	const struct fdt_header *fdt = infdt;
+
+	if (fdt->magic != cpu_to_fdt32(FDT_MAGIC)) {
+		pr_err("bad magic: 0x%08x\n", fdt32_to_cpu(fdt->magic));
+		return ERR_PTR(-EINVAL);
+	}
+
+	if (fdt->version != cpu_to_fdt32(17)) {
+		pr_err("bad dt version: 0x%08x\n", fdt32_to_cpu(fdt->version));
+		return ERR_PTR(-EINVAL);
+	}
+
+	f.totalsize = fdt32_to_cpu(fdt->totalsize);
+	f.off_dt_struct = fdt32_to_cpu(fdt->off_dt_struct);
+	f.size_dt_struct = fdt32_to_cpu(fdt->size_dt_struct);
+	f.off_dt_strings = fdt32_to_cpu(fdt->off_dt_strings);
+	f.size_dt_strings = fdt32_to_cpu(fdt->size_dt_strings);
+
+	if (f.off_dt_struct + f.size_dt_struct > f.totalsize) {
+		pr_err("unflatten: dt size exceeds total size\n");
+		return ERR_PTR(-ESPIPE);
 	}
-err:
-	of_delete_node(root);
 
-	return ERR_PTR(ret);
+	if (f.off_dt_strings + f.size_dt_strings > f.totalsize) {
+		pr_err("unflatten: string size exceeds total size\n");
+		return ERR_PTR(-ESPIPE);
+	}
+
+	ret = of_unflatten_pass(infdt, &f, &ctx, NULL);
+	if (ret)
+		return ERR_PTR(ret);
+
+	/* values go right after the structs to keep them 4 byte aligned */
+	size = sizeof(*arena) +
+		ctx.nodes * sizeof(struct device_node) +
+		ctx.properties * sizeof(struct property) +
+		ctx.values + f.size_dt_strings + 1 + ctx.names;
+
+	mem = xzalloc(size);
+
+	arena = mem;
+	arena->start = mem;
+	arena->end = mem + size;
+	arena->users = ctx.nodes + ctx.properties;
+	mem += sizeof(*arena);
+
+	ctx.node_mem = mem;
+	mem += ctx.nodes * sizeof(struct device_node);
+	ctx.prop_mem = mem;
+	mem += ctx.properties * sizeof(struct property);
+	ctx.value_mem = mem;
+	mem += ctx.values;
+	ctx.strings = mem;
+	memcpy(ctx.strings, infdt + f.off_dt_strings, f.size_dt_strings);
+	mem += f.size_dt_strings + 1;
+	ctx.name_mem = mem;
+
+	list_add(&arena->list, &of_arenas);
+
+	ret = of_unflatten_pass(infdt, &f, &ctx, &root);
+	if (ret) {
+		/* cannot happen after the first pass succeeded */
+		ctx.node_mem = arena->start + sizeof(*arena);
+		for (i = 0; i < ctx.nodes; i++)
+			hlist_del_init(&ctx.node_mem[i].phandle_hash);
+		list_del(&arena->list);
+		free(arena);
+		return ERR_PTR(ret);
+	}
+
+	return root;
 }
 
 struct fdt {
@@ -201,116 +369,59 @@ static inline uint32_t dt_next_ofs(uint32_t curofs, uint32_t len)
 	return ALIGN(curofs + len, 4);
 }
 
-static int lstrcpy(char *dest, const char *src)
-{
-	int len = 0;
-	int maxlen = 1023;
-
-	while (*src) {
-		*dest++ = *src++;
-		len++;
-		if (!maxlen)
-			return -ENOSPC;
-		maxlen--;
-	}
-
-	return len;
-}
-
-static void *memalign_realloc(void *orig, size_t oldsize, size_t newsize)
+/*
+ * Sizing pass of the flattener: account for the structure block and
+ * the strings block @node will occupy, so that the blob can be
+ * allocated once and emitted without ever being grown.
+ */
+static void __of_flatten_dtb_size(struct fdt *fdt, struct device_node *node)
 {
-	int align;
-	void *newbuf;
-
-	/*
-	 * ARM Linux uses a single 1MiB section (with 1MiB alignment)
-	 * for mapping the devicetree, so we are not allowed to cross
-	 * 1MiB boundaries. This got fixed in the Kernel since v3.8-rc5
-	 */
-	align = 1 << fls(newsize - 1);
-
-	if (!orig)
-		return memalign(align, newsize);
-
-	newbuf = memalign(align, newsize);
-	if (!newbuf) {
-		free(orig);
-		return NULL;
-	}
+	struct property *p;
+	struct device_node *n;
 
-	memcpy(newbuf, orig, oldsize);
-	free(orig);
-	memset(newbuf + oldsize, 0, newsize - oldsize);
+	fdt->dt_size = dt_next_ofs(fdt->dt_size,
+			sizeof(struct fdt_node_header) + strlen(node->name) + 1);
 
-	return newbuf;
-}
-
-static int fdt_ensure_space(struct fdt *fdt, int dtsize)
-{
-	/*
-	 * We assume strings and names have a maximum length of 1024
-	 * whereas properties can be longer. We allocate new memory
-	 * if we have less than 1024 bytes (+ the property size left.
-	 */
-	if (fdt->str_size - fdt->str_nextofs < 1024) {
-		fdt->strings = realloc(fdt->strings, fdt->str_size * 2);
-		if (!fdt->strings)
-			return -ENOMEM;
-		fdt->str_size *= 2;
+	list_for_each_entry(p, &node->properties, list) {
+		fdt->dt_size = dt_next_ofs(fdt->dt_size,
+				sizeof(struct fdt_property) + p->length);
+		fdt->str_size += strlen(p->name) + 1;
 	}
 
-	if (fdt->dt_size - fdt->dt_nextofs < 1024 + dtsize) {
-		fdt->dt = memalign_realloc(fdt->dt, fdt->dt_size,
-				fdt->dt_size * 2);
-		if (!fdt->dt)
-			return -ENOMEM;
-		fdt->dt_size *= 2;
-	}
+	list_for_each_entry(n, &node->children, parent_list)
+		__of_flatten_dtb_size(fdt, n);
 
-	return 0;
+	fdt->dt_size = dt_next_ofs(fdt->dt_size,
+			sizeof(struct fdt_node_header));
 }
 
-static inline int dt_add_string(struct fdt *fdt, const char *str)
+static inline uint32_t dt_add_string(struct fdt *fdt, const char *str)
 {
-	uint32_t ret;
-	int len;
+	uint32_t ret = fdt->str_nextofs;
+	int len = strlen(str) + 1;
 
-	if (fdt_ensure_space(fdt, 0) < 0)
-		return -ENOMEM;
-
-	len = lstrcpy(fdt->strings + fdt->str_nextofs, str);
-	if (len < 0)
-		return -ENOSPC;
-
-	ret = fdt->str_nextofs;
-
-	fdt->str_nextofs += len + 1;
+	memcpy(fdt->strings + fdt->str_nextofs, str, len);
+	fdt->str_nextofs += len;
 
 	return ret;
 }
 
-static int __of_flatten_dtb(struct fdt *fdt, struct device_node *node)
+static void __of_flatten_dtb(struct fdt *fdt, struct device_node *node)
 {
 	struct property *p;
 	struct device_node *n;
-	int ret;
 	unsigned int len;
 	struct fdt_node_header *nh;
 
-	if (fdt_ensure_space(fdt, 0) < 0)
-		return -ENOMEM;
-
 	nh = fdt->dt + fdt->dt_nextofs;
 	nh->tag = cpu_to_fdt32(FDT_BEGIN_NODE);
-	len = lstrcpy(nh->name, node->name);
+	len = strlen(node->name);
+	memcpy(nh->name, node->name, len + 1);
 	fdt->dt_nextofs = dt_next_ofs(fdt->dt_nextofs, 4 + len + 1);
 
 	list_for_each_entry(p, &node->properties, list) {
 		struct fdt_property *fp;
 
-		if (fdt_ensure_space(fdt, p->length) < 0)
-			return -ENOMEM;
-
 		fp = fdt->dt + fdt->dt_nextofs;
 
 		fp->tag = cpu_to_fdt32(FDT_PROP);
@@ -321,89 +432,144 @@ static int __of_flatten_dtb(struct fdt *fdt, struct device_node *node)
 				sizeof(struct fdt_property) + p->length);
 	}
 
-	list_for_each_entry(n, &node->children, parent_list) {
-		ret = __of_flatten_dtb(fdt, n);
-		if (ret)
-			return ret;
-	}
+	list_for_each_entry(n, &node->children, parent_list)
+		__of_flatten_dtb(fdt, n);
 
 	nh = fdt->dt + fdt->dt_nextofs;
 	nh->tag = cpu_to_fdt32(FDT_END_NODE);
 	fdt->dt_nextofs = dt_next_ofs(fdt->dt_nextofs,
 			sizeof(struct fdt_node_header));
+}
+
+static void *fdt_alloc(size_t size)
+{
+	/*
+	 * ARM Linux uses a single 1MiB section (with 1MiB alignment)
+	 * for mapping the devicetree, so we are not allowed to cross
+	 * 1MiB boundaries. This got fixed in the Kernel since v3.8-rc5
+	 */
+	return memalign(1 << fls(size - 1), size);
+}
 
-	if (fdt_ensure_space(fdt, 0) < 0)
-		return -ENOMEM;
+/*
+ * The last blob flattened from the live tree. It stays valid until
+ * of_tree_changed() reports a modification of a node in that tree.
+ */
+static struct {
+	struct device_node *root;
+	void *fdt;
+	bool dirty;
+} of_flat_cache;
 
-	return 0;
+/**
+ * of_tree_changed - invalidate the cached flattened tree
+ * @node - the modified node, NULL if unknown
+ *
+ * Must be called by everything that modifies a device_node or its
+ * properties, so that the next of_flatten_dtb() of the live tree
+ * walks the tree again. Modifications of other trees, like the
+ * copies bootm and of_dump work on, leave the cache alone.
+ */
+void of_tree_changed(struct device_node *node)
+{
+	if (!node || of_find_root_node(node) == of_flat_cache.root)
+		of_flat_cache.dirty = true;
+}
+
+static void *of_flat_cache_get(struct device_node *node)
+{
+	size_t size;
+	void *fdt;
+
+	if (of_flat_cache.dirty || !of_flat_cache.fdt ||
+	    of_flat_cache.root != node)
+		return NULL;
+
+	size = fdt32_to_cpu(((struct fdt_header *)of_flat_cache.fdt)->totalsize);
+
+	fdt = fdt_alloc(size);
+	if (!fdt)
+		return NULL;
+
+	return memcpy(fdt, of_flat_cache.fdt, size);
+}
+
+static void of_flat_cache_put(struct device_node *node, void *fdt)
+{
+	size_t size = fdt32_to_cpu(((struct fdt_header *)fdt)->totalsize);
+
+	if (node != of_get_root_node())
+		return;
+
+	free(of_flat_cache.fdt);
+	of_flat_cache.fdt = malloc(size);
+	if (!of_flat_cache.fdt)
+		return;
+
+	memcpy(of_flat_cache.fdt, fdt, size);
+	of_flat_cache.root = node;
+	of_flat_cache.dirty = false;
 }
 
 /**
  * of_flatten_dtb - flatten a barebox internal devicetree to a dtb
  * @node - the root node of the tree to be unflattened
+ *
+ * The size of the blob is computed up front, so it is emitted in a
+ * single pass. For the live tree the result is cached until the tree
+ * is modified. The returned blob is always a private copy the caller
+ * has to free.
  */
 void *of_flatten_dtb(struct device_node *node)
 {
-	int ret;
 	struct fdt_header header = {};
 	struct fdt fdt = {};
-	uint32_t ofs;
+	uint32_t ofs, size;
 	struct fdt_node_header *nh;
 
-	header.magic = cpu_to_fdt32(FDT_MAGIC);
-	header.version = cpu_to_fdt32(0x11);
-	header.last_comp_version = cpu_to_fdt32(0x10);
+	fdt.dt = of_flat_cache_get(node);
+	if (fdt.dt)
+		return fdt.dt;
 
-	fdt.dt = xmemalign(SZ_64K, SZ_64K);
-	fdt.dt_size = SZ_64K;
+	ofs = sizeof(struct fdt_header);
+	ofs += sizeof(struct fdt_reserve_entry) * OF_MAX_RESERVE_MAP;
 
-	fdt.strings = xzalloc(SZ_64K);
-	fdt.str_size = SZ_64K;
+	fdt.dt_size = ofs;
+	__of_flatten_dtb_size(&fdt, node);
+	fdt.dt_size = dt_next_ofs(fdt.dt_size, sizeof(struct fdt_node_header));
 
-	memset(fdt.dt, 0, SZ_64K);
+	size = fdt.dt_size + fdt.str_size;
 
-	ofs = sizeof(struct fdt_header);
+	fdt.dt = fdt_alloc(size);
+	if (!fdt.dt)
+		return NULL;
 
-	header.off_mem_rsvmap = cpu_to_fdt32(ofs);
-	ofs += sizeof(struct fdt_reserve_entry) * OF_MAX_RESERVE_MAP;
+	memset(fdt.dt, 0, size);
 
 	fdt.dt_nextofs = ofs;
+	fdt.strings = fdt.dt + fdt.dt_size;
+
+	__of_flatten_dtb(&fdt, node);
 
-	ret = __of_flatten_dtb(&fdt, node);
-	if (ret)
-		goto out_free;
 	nh = fdt.dt + fdt.dt_nextofs;
 	nh->tag = cpu_to_fdt32(FDT_END);
 	fdt.dt_nextofs = dt_next_ofs(fdt.dt_nextofs, sizeof(struct fdt_node_header));
 
+	header.magic = cpu_to_fdt32(FDT_MAGIC);
+	header.totalsize = cpu_to_fdt32(size);
 	header.off_dt_struct = cpu_to_fdt32(ofs);
-	header.size_dt_struct = cpu_to_fdt32(fdt.dt_nextofs - ofs);
-
-	header.off_dt_strings = cpu_to_fdt32(fdt.dt_nextofs);
-	header.size_dt_strings = cpu_to_fdt32(fdt.str_nextofs);
-
-	if (fdt.dt_size - fdt.dt_nextofs < fdt.str_nextofs) {
-		fdt.dt = memalign_realloc(fdt.dt, fdt.dt_size,
-				fdt.dt_nextofs + fdt.str_nextofs);
-		if (!fdt.dt)
-			goto out_free;
-	}
-
-	memcpy(fdt.dt + fdt.dt_nextofs, fdt.strings, fdt.str_nextofs);
-
-	header.totalsize = cpu_to_fdt32(fdt.dt_nextofs + fdt.str_nextofs);
+	header.off_dt_strings = cpu_to_fdt32(fdt.dt_size);
+	header.off_mem_rsvmap = cpu_to_fdt32(sizeof(struct fdt_header));
+	header.version = cpu_to_fdt32(0x11);
+	header.last_comp_version = cpu_to_fdt32(0x10);
+	header.size_dt_strings = cpu_to_fdt32(fdt.str_size);
+	header.size_dt_struct = cpu_to_fdt32(fdt.dt_size - ofs);
 
 	memcpy(fdt.dt, &header, sizeof(header));
 
-	free(fdt.strings);
+	of_flat_cache_put(node, fdt.dt);
 
 	return fdt.dt;
-
-out_free:
-	free(fdt.strings);
-	free(fdt.dt);
-
-	return NULL;
 }
 
 /*
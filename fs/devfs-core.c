@@ -57,6 +57,39 @@ struct cdev *cdev_by_name(const char *filename)
 	return NULL;
 }
 
+/**
+ * cdev_by_name_detect - find a cdev, detecting its device if necessary
+ * @name: the name of the cdev
+ *
+ * Devices like MMC cards are only detected on demand and don't have
+ * cdevs before. If no cdev @name exists, detect the device it would
+ * belong to, i.e. "mmc0" for "mmc0.0", and look again. Detection is
+ * only done for devices which have no cdevs yet, so a lookup of an
+ * unknown partition of an already detected device has no side effects.
+ */
+struct cdev *cdev_by_name_detect(const char *name)
+{
+	struct cdev *cdev;
+	struct device_d *dev;
+	char *devname, *str;
+
+	cdev = cdev_by_name(name);
+	if (cdev)
+		return cdev;
+
+	str = devname = xstrdup(name);
+	strsep(&str, ".");
+	dev = get_device_by_name(devname);
+	free(devname);
+
+	if (!dev || !list_empty(&dev->cdevs))
+		return NULL;
+
+	device_detect(dev);
+
+	return cdev_by_name(name);
+}
+
 struct cdev *cdev_by_device_node(struct device_node *node)
 {
 	struct cdev *cdev;
@@ -121,7 +154,7 @@ int cdev_do_open(struct cdev *cdev, unsigned long flags)
 
 struct cdev *cdev_open(const char *name, unsigned long flags)
 {
-	struct cdev *cdev = cdev_by_name(name);
+	struct cdev *cdev = cdev_by_name_detect(name);
 	int ret;
 
 	if (!cdev)
@@ -113,7 +113,7 @@ static int devfs_open(struct device_d *_dev, FILE *f, const char *filename)
 	struct cdev *cdev;
 	int ret;
 
-	cdev = cdev_by_name(filename + 1);
+	cdev = cdev_by_name_detect(filename + 1);
 
 	if (!cdev)
 		return -ENOENT;
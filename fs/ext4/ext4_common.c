@@ -34,60 +34,29 @@
 #include <linux/time.h>
 #include <asm/byteorder.h>
 #include <dma.h>
+#include <linux/hash.h>
 
 #include "ext4_common.h"
 
-static struct ext4_extent_header *ext4fs_get_extent_block(struct ext2_data *data,
-		char *buf, struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
-{
-	struct ext4_extent_idx *index;
-	unsigned long long block;
-	struct ext_filesystem *fs = data->fs;
-	int blksz = EXT2_BLOCK_SIZE(data);
-	int i, ret;
-
-	while (1) {
-		index = (struct ext4_extent_idx *)(ext_block + 1);
-
-		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC)
-			return 0;
-
-		if (ext_block->eh_depth == 0)
-			return ext_block;
-		i = -1;
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(index[i].ei_block));
-
-		if (--i < 0)
-			return 0;
-
-		block = le16_to_cpu(index[i].ei_leaf_hi);
-		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
-
-		ret = ext4fs_devread(fs, block << log2_blksz, 0, blksz, buf);
-		if (ret)
-			return NULL;
-		else
-			ext_block = (struct ext4_extent_header *)buf;
-	}
-}
-
 static int ext4fs_blockgroup(struct ext2_data *data, int group,
 		struct ext2_block_group *blkgrp)
 {
 	long int blkno;
-	unsigned int blkoff, desc_per_blk;
+	unsigned int blkoff, desc_per_blk, desc_size;
 	struct ext_filesystem *fs = data->fs;
 
-	desc_per_blk = EXT2_BLOCK_SIZE(data) / sizeof(struct ext2_block_group);
+	/* 64bit filesystems have larger group descriptors */
+	desc_size = sizeof(struct ext2_block_group);
+	if (__le32_to_cpu(data->sblock.feature_incompat) &
+			EXT4_FEATURE_INCOMPAT_64BIT)
+		desc_size = max_t(unsigned int, desc_size,
+				__le16_to_cpu(data->sblock.descriptor_size));
+
+	desc_per_blk = EXT2_BLOCK_SIZE(data) / desc_size;
 
 	blkno = __le32_to_cpu(data->sblock.first_data_block) + 1 +
 			group / desc_per_blk;
-	blkoff = (group % desc_per_blk) * sizeof(struct ext2_block_group);
+	blkoff = (group % desc_per_blk) * desc_size;
 
 	dev_dbg(fs->dev, "read %d group descriptor (blkno %ld blkoff %u)\n",
 	      group, blkno, blkoff);
@@ -137,77 +106,203 @@ int ext4fs_get_indir_block(struct ext2fs_node *node, struct ext4fs_indir_block *
 	if (indir->blkno == blkno)
 		return 0;
 
+	/* a hole in a sparse file */
+	if (!blkno) {
+		memset(indir->data, 0, blksz);
+		indir->blkno = 0;
+		return 0;
+	}
+
 	ret = ext4fs_devread(fs, blkno, 0, blksz, (void *)indir->data);
 	if (ret) {
 		dev_err(fs->dev, "** SI ext2fs read block (indir 1)"
 			"failed. **\n");
+		indir->blkno = -1;
 		return ret;
 	}
 
+	indir->blkno = blkno;
+
 	return 0;
 }
 
-long int read_allocated_block(struct ext2fs_node *node, int fileblock)
+/*
+ * Append the extents of the (sub)tree below @hdr to the extent cache of
+ * @node. @size is the size of the buffer @hdr lives in.
+ */
+static int ext4fs_read_extents(struct ext2fs_node *node,
+		struct ext4_extent_header *hdr, int size, int depth)
 {
-	long int blknr;
-	int blksz;
-	int log2_blksz;
-	long int rblock;
-	long int perblock_parent;
-	long int perblock_child;
-	unsigned long long start;
-	struct ext2_inode *inode = &node->inode;
 	struct ext2_data *data = node->data;
-	int ret;
+	int blksz = EXT2_BLOCK_SIZE(data);
+	int entries = le16_to_cpu(hdr->eh_entries);
+	int i, ret;
 
-	/* get the blocksize of the filesystem */
-	blksz = EXT2_BLOCK_SIZE(node->data);
-	log2_blksz = LOG2_EXT2_BLOCK_SIZE(node->data);
+	if (le16_to_cpu(hdr->eh_magic) != EXT4_EXT_MAGIC ||
+			le16_to_cpu(hdr->eh_depth) != depth ||
+			(entries + 1) * sizeof(struct ext4_extent) > size)
+		return -EINVAL;
+
+	if (!depth) {
+		struct ext4_extent *extent = (struct ext4_extent *)(hdr + 1);
+		struct ext4fs_extent_map *map;
+
+		map = realloc(node->extents,
+			(node->num_extents + entries) * sizeof(*map));
+		if (!map)
+			return -ENOMEM;
+
+		node->extents = map;
+		map += node->num_extents;
+
+		for (i = 0; i < entries; i++, map++) {
+			map->block = le32_to_cpu(extent[i].ee_block);
+			map->len = le16_to_cpu(extent[i].ee_len);
+			map->start = le16_to_cpu(extent[i].ee_start_hi);
+			map->start = (map->start << 32) +
+					le32_to_cpu(extent[i].ee_start_lo);
+
+			/* unwritten extents read as zeroes like holes */
+			if (map->len > EXT4_EXT_INIT_MAX_LEN) {
+				map->len -= EXT4_EXT_INIT_MAX_LEN;
+				map->start = 0;
+			}
+		}
+
+		node->num_extents += entries;
+
+		return 0;
+	}
+
+	if (depth > EXT4_MAX_EXTENT_DEPTH)
+		return -EINVAL;
 
-	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		char *buf = zalloc(blksz);
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i = -1;
+	for (i = 0; i < entries; i++) {
+		struct ext4_extent_idx *index = (struct ext4_extent_idx *)(hdr + 1);
+		unsigned long long block;
+		char *buf;
 
+		block = le16_to_cpu(index[i].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+
+		buf = malloc(blksz);
 		if (!buf)
 			return -ENOMEM;
 
-		ext_block = ext4fs_get_extent_block(node->data, buf,
-				(struct ext4_extent_header *)inode->b.blocks.dir_blocks,
-				fileblock, log2_blksz);
-		if (!ext_block) {
+		ret = ext4fs_devread(data->fs,
+				block << LOG2_EXT2_BLOCK_SIZE(data), 0,
+				blksz, buf);
+		if (!ret)
+			ret = ext4fs_read_extents(node,
+					(struct ext4_extent_header *)buf,
+					blksz, depth - 1);
+		free(buf);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Look up @fileblock in the extent cache of @node, decoding the extent
+ * tree of the inode on first use. Returns the physical block or 0 for a
+ * hole and the number of blocks mapped the same way in @nblocks.
+ */
+static long int ext4fs_map_extent(struct ext2fs_node *node, int fileblock,
+		int *nblocks)
+{
+	struct ext4fs_extent_map *map;
+	int lo, hi, i;
+
+	if (!node->extents_read) {
+		struct ext4_extent_header *hdr = (struct ext4_extent_header *)
+			node->inode.b.blocks.dir_blocks;
+		int ret;
+
+		ret = ext4fs_read_extents(node, hdr, sizeof(node->inode.b),
+				le16_to_cpu(hdr->eh_depth));
+		if (ret) {
 			pr_err("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
+			free(node->extents);
+			node->extents = NULL;
+			node->num_extents = 0;
+			return ret;
 		}
 
-		extent = (struct ext4_extent *)(ext_block + 1);
+		node->extents_read = 1;
+	}
 
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(extent[i].ee_block));
+	/* files are mostly read sequentially, try the last extent first */
+	i = node->last_extent;
+	map = node->extents;
+
+	if (i >= node->num_extents || fileblock < map[i].block ||
+			fileblock >= map[i].block + map[i].len) {
+		lo = 0;
+		hi = node->num_extents;
+
+		while (lo < hi) {
+			i = (lo + hi) / 2;
+			if (fileblock < map[i].block)
+				hi = i;
+			else
+				lo = i + 1;
+		}
 
-		if (--i >= 0) {
-			fileblock -= le32_to_cpu(extent[i].ee_block);
-			if (fileblock >= le16_to_cpu(extent[i].ee_len)) {
-				free(buf);
-				return 0;
-			}
+		/* lo is the first extent starting after fileblock */
+		i = lo - 1;
+	}
 
-			start = le16_to_cpu(extent[i].ee_start_hi);
-			start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-			free(buf);
-			return fileblock + start;
-		}
+	if (i < 0 || fileblock >= map[i].block + map[i].len) {
+		/* hole up to the next extent */
+		if (i + 1 < node->num_extents)
+			*nblocks = map[i + 1].block - fileblock;
+		else
+			*nblocks = INT_MAX;
 
-		free(buf);
-		return -EIO;
+		return 0;
 	}
 
+	node->last_extent = i;
+	*nblocks = map[i].block + map[i].len - fileblock;
+
+	if (!map[i].start)
+		return 0;
+
+	return map[i].start + fileblock - map[i].block;
+}
+
+/*
+ * Map @fileblock of @node to a physical block, 0 for a hole. If @nblocks
+ * is given, it returns the number of blocks from @fileblock on known to
+ * be physically contiguous (or a hole).
+ */
+long int read_allocated_block(struct ext2fs_node *node, int fileblock,
+		int *nblocks)
+{
+	long int blknr;
+	int blksz;
+	int log2_blksz;
+	long int rblock;
+	long int perblock_parent;
+	long int perblock_child;
+	struct ext2_inode *inode = &node->inode;
+	struct ext2_data *data = node->data;
+	int ret, dummy;
+
+	if (!nblocks)
+		nblocks = &dummy;
+
+	/* get the blocksize of the filesystem */
+	blksz = EXT2_BLOCK_SIZE(node->data);
+	log2_blksz = LOG2_EXT2_BLOCK_SIZE(node->data);
+
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extent(node, fileblock, nblocks);
+
+	*nblocks = 1;
+
 	if (fileblock < INDIRECT_BLOCKS) {
 		/* Direct blocks. */
 		blknr = __le32_to_cpu(inode->b.blocks.dir_blocks[fileblock]);
@@ -263,13 +358,277 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	return blknr;
 }
 
+static struct hlist_head *ext4fs_dcache_bucket(struct ext2_data *data,
+		int dir, const char *name)
+{
+	u32 h = dir;
+
+	while (*name)
+		h = h * 31 + *name++;
+
+	return &data->dcache[hash_32(h, EXT4_DCACHE_HASH_BITS)];
+}
+
+static struct ext4fs_dentry *ext4fs_dcache_lookup(struct ext2_data *data,
+		int dir, const char *name)
+{
+	struct ext4fs_dentry *dentry;
+	struct hlist_node *n;
+
+	hlist_for_each_entry(dentry, n, ext4fs_dcache_bucket(data, dir, name),
+			hash)
+		if (dentry->dir == dir && !strcmp(dentry->name, name))
+			return dentry;
+
+	return NULL;
+}
+
+static void ext4fs_dcache_add(struct ext2_data *data, int dir,
+		const char *name, int ino, int type, struct ext2_inode *inode)
+{
+	struct ext4fs_dentry *dentry;
+
+	/* drop the oldest entry when full */
+	if (data->dcache_num == EXT4_DCACHE_MAX) {
+		dentry = list_first_entry(&data->dcache_list,
+				struct ext4fs_dentry, list);
+		hlist_del(&dentry->hash);
+		list_del(&dentry->list);
+		free(dentry);
+		data->dcache_num--;
+	}
+
+	dentry = malloc(sizeof(*dentry) + strlen(name) + 1);
+	if (!dentry)
+		return;
+
+	dentry->dir = dir;
+	dentry->ino = ino;
+	dentry->type = type;
+	if (inode)
+		dentry->inode = *inode;
+	strcpy(dentry->name, name);
+
+	hlist_add_head(&dentry->hash, ext4fs_dcache_bucket(data, dir, name));
+	list_add_tail(&dentry->list, &data->dcache_list);
+	data->dcache_num++;
+}
+
+static void ext4fs_dcache_free(struct ext2_data *data)
+{
+	struct ext4fs_dentry *dentry, *tmp;
+
+	list_for_each_entry_safe(dentry, tmp, &data->dcache_list, list)
+		free(dentry);
+}
+
+/* Find @name in the directory block @buf, entries never cross blocks */
+static struct ext2_dirent *ext4fs_search_dirblock(char *buf, int len,
+		const char *name, int namelen)
+{
+	int offset = 0;
+
+	while (offset + sizeof(struct ext2_dirent) <= len) {
+		struct ext2_dirent *dirent = (struct ext2_dirent *)(buf + offset);
+		int direntlen = __le16_to_cpu(dirent->direntlen);
+
+		if (direntlen < sizeof(struct ext2_dirent) ||
+				offset + direntlen > len)
+			return NULL;
+
+		if (dirent->inode && dirent->namelen == namelen &&
+				sizeof(struct ext2_dirent) + namelen <= direntlen &&
+				!memcmp(dirent + 1, name, namelen))
+			return dirent;
+
+		offset += direntlen;
+	}
+
+	return NULL;
+}
+
+static int ext4fs_find_dirent_linear(struct ext2fs_node *diro,
+		const char *name, char *buf, struct ext2_dirent *found)
+{
+	int blksz = EXT2_BLOCK_SIZE(diro->data);
+	unsigned int size = __le32_to_cpu(diro->inode.size);
+	struct ext2_dirent *dirent;
+	unsigned int fpos;
+	int status;
+
+	for (fpos = 0; fpos < size; fpos += blksz) {
+		status = ext4fs_read_file(diro, fpos, min(size - fpos,
+					(unsigned int)blksz), buf);
+		if (status < 1)
+			return -EINVAL;
+
+		dirent = ext4fs_search_dirblock(buf, status, name,
+				strlen(name));
+		if (dirent) {
+			*found = *dirent;
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * Find @name using the htree index of @diro. Returns -EOPNOTSUPP if
+ * the directory is not indexed or the index can't be used, so that
+ * the caller falls back to a linear search.
+ */
+static int ext4fs_find_dirent_dx(struct ext2fs_node *diro, const char *name,
+		char *buf, struct ext2_dirent *found)
+{
+	struct ext2_data *data = diro->data;
+	int blksz = EXT2_BLOCK_SIZE(data);
+	int namelen = strlen(name);
+	struct dx_root_info *info;
+	struct dx_entry *entries, *at, *p, *q;
+	struct dx_countlimit *countlimit;
+	struct ext2_dirent *dirent;
+	uint32_t hash, seed[4];
+	int levels, indirect, version, count, i, ret;
+	char *leaf;
+
+	if (!(__le32_to_cpu(data->sblock.feature_compatibility) &
+			EXT4_FEATURE_COMPAT_DIR_INDEX) ||
+			!(__le32_to_cpu(diro->inode.flags) & EXT4_INDEX_FL))
+		return -EOPNOTSUPP;
+
+	ret = ext4fs_read_file(diro, 0, blksz, buf);
+	if (ret < 0)
+		return ret;
+	if (ret < blksz)
+		return -EOPNOTSUPP;
+
+	/* skip the "." and ".." entries */
+	info = (struct dx_root_info *)(buf + 2 * 12);
+	indirect = info->indirect_levels;
+	version = info->hash_version;
+
+	if (info->reserved_zero || version > DX_HASH_TEA ||
+			(info->unused_flags & 1) || info->info_length < 8 ||
+			indirect >= EXT4_HTREE_LEVEL)
+		return -EOPNOTSUPP;
+
+	if (__le32_to_cpu(data->sblock.flags) & EXT2_FLAGS_UNSIGNED_HASH)
+		version += DX_HASH_LEGACY_UNSIGNED;
+
+	for (i = 0; i < 4; i++)
+		seed[i] = __le32_to_cpu(data->sblock.hash_seed[i]);
+
+	if (ext4fs_dirhash(name, namelen, version, seed, &hash))
+		return -EOPNOTSUPP;
+
+	entries = (struct dx_entry *)((char *)info + info->info_length);
+
+	for (levels = indirect; ; levels--) {
+		countlimit = (struct dx_countlimit *)entries;
+		count = __le16_to_cpu(countlimit->count);
+
+		if (!count || count > __le16_to_cpu(countlimit->limit) ||
+				(char *)(entries + count) > buf + blksz)
+			return -EOPNOTSUPP;
+
+		/* the first entry has no hash, it covers everything below */
+		p = entries + 1;
+		q = entries + count - 1;
+		while (p <= q) {
+			struct dx_entry *m = p + (q - p) / 2;
+
+			if (__le32_to_cpu(m->hash) > hash)
+				q = m - 1;
+			else
+				p = m + 1;
+		}
+		at = p - 1;
+
+		if (!levels)
+			break;
+
+		ret = ext4fs_read_file(diro,
+				(__le32_to_cpu(at->block) & 0x00ffffff) * blksz,
+				blksz, buf);
+		if (ret < 0)
+			return ret;
+		if (ret < blksz)
+			return -EOPNOTSUPP;
+
+		entries = (struct dx_entry *)(buf + sizeof(struct ext2_dirent));
+	}
+
+	leaf = malloc(blksz);
+	if (!leaf)
+		return -ENOMEM;
+
+	while (1) {
+		ret = ext4fs_read_file(diro,
+				(__le32_to_cpu(at->block) & 0x00ffffff) * blksz,
+				blksz, leaf);
+		if (ret < 0)
+			break;
+
+		dirent = ext4fs_search_dirblock(leaf, ret, name, namelen);
+		if (dirent) {
+			*found = *dirent;
+			ret = 0;
+			break;
+		}
+
+		/*
+		 * The lowest bit of the hash marks names with the same hash
+		 * continuing in the next block. If that is in the next index
+		 * node, let the caller search linearly.
+		 */
+		if (++at == entries + count) {
+			ret = indirect ? -EOPNOTSUPP : -ENOENT;
+			break;
+		}
+
+		if (!(__le32_to_cpu(at->hash) & 1) ||
+				(__le32_to_cpu(at->hash) & ~1) != hash) {
+			ret = -ENOENT;
+			break;
+		}
+	}
+
+	free(leaf);
+
+	return ret;
+}
+
+static int ext4fs_inode_type(struct ext2_inode *inode)
+{
+	switch (__le16_to_cpu(inode->mode) & FILETYPE_INO_MASK) {
+	case FILETYPE_INO_DIRECTORY:
+		return FILETYPE_DIRECTORY;
+	case FILETYPE_INO_SYMLINK:
+		return FILETYPE_SYMLINK;
+	case FILETYPE_INO_REG:
+		return FILETYPE_REG;
+	default:
+		return FILETYPE_UNKNOWN;
+	}
+}
+
+/*
+ * Look up @name in the directory @dir, using the dentry cache, the
+ * htree index if the directory has one or a linear search otherwise.
+ * The inode of the node returned in @fnode has already been read.
+ */
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
-	unsigned int fpos = 0;
-	int status, ret;
 	struct ext2fs_node *diro = (struct ext2fs_node *) dir;
-	struct ext_filesystem *fs = dir->data->fs;
+	struct ext2_data *data = dir->data;
+	struct ext_filesystem *fs = data->fs;
+	struct ext4fs_dentry *dentry;
+	struct ext2fs_node *fdiro;
+	struct ext2_dirent dirent;
+	char *buf;
+	int ret;
 
 	if (name != NULL)
 		dev_dbg(fs->dev, "Iterate dir %s\n", name);
@@ -279,85 +638,67 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (ret)
 			return ret;
 	}
-	/* Search the file.  */
-	while (fpos < __le32_to_cpu(diro->inode.size)) {
-		struct ext2_dirent dirent;
-
-		status = ext4fs_read_file(diro, fpos,
-					   sizeof(struct ext2_dirent),
-					   (char *) &dirent);
-		if (status < 1)
-			return -EINVAL;
 
-		if (dirent.namelen != 0) {
-			char filename[dirent.namelen + 1];
-			struct ext2fs_node *fdiro;
-			int type = FILETYPE_UNKNOWN;
-
-			status = ext4fs_read_file(diro,
-						  fpos +
-						  sizeof(struct ext2_dirent),
-						  dirent.namelen, filename);
-			if (status < 1)
-				return -EINVAL;
-
-			fdiro = zalloc(sizeof(struct ext2fs_node));
-			if (!fdiro)
-				return -ENOMEM;
-
-			fdiro->data = diro->data;
-			fdiro->ino = __le32_to_cpu(dirent.inode);
-
-			filename[dirent.namelen] = '\0';
-
-			if (dirent.filetype != FILETYPE_UNKNOWN) {
-				fdiro->inode_read = 0;
-
-				if (dirent.filetype == FILETYPE_DIRECTORY)
-					type = FILETYPE_DIRECTORY;
-				else if (dirent.filetype == FILETYPE_SYMLINK)
-					type = FILETYPE_SYMLINK;
-				else if (dirent.filetype == FILETYPE_REG)
-					type = FILETYPE_REG;
-			} else {
-				ret = ext4fs_read_inode(diro->data,
-							   __le32_to_cpu
-							   (dirent.inode),
-							   &fdiro->inode);
-				if (ret) {
-					free(fdiro);
-					return ret;
-				}
-				fdiro->inode_read = 1;
-
-				if ((__le16_to_cpu(fdiro->inode.mode) &
-				     FILETYPE_INO_MASK) ==
-				    FILETYPE_INO_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if ((__le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if ((__le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_REG) {
-					type = FILETYPE_REG;
-				}
-			}
-
-			dev_dbg(fs->dev, "iterate >%s<\n", filename);
+	fdiro = zalloc(sizeof(struct ext2fs_node));
+	if (!fdiro)
+		return -ENOMEM;
 
-			if (strcmp(filename, name) == 0) {
-				*ftype = type;
-				*fnode = fdiro;
-				return 0;
-			}
+	fdiro->data = data;
 
+	dentry = ext4fs_dcache_lookup(data, diro->ino, name);
+	if (dentry) {
+		if (!dentry->ino) {
 			free(fdiro);
+			return -ENOENT;
 		}
-		fpos += __le16_to_cpu(dirent.direntlen);
+
+		fdiro->ino = dentry->ino;
+		fdiro->inode = dentry->inode;
+		fdiro->inode_read = 1;
+		*ftype = dentry->type;
+		*fnode = fdiro;
+
+		return 0;
 	}
-	return -ENOENT;
+
+	buf = malloc(EXT2_BLOCK_SIZE(data));
+	if (!buf) {
+		free(fdiro);
+		return -ENOMEM;
+	}
+
+	ret = ext4fs_find_dirent_dx(diro, name, buf, &dirent);
+	if (ret == -EOPNOTSUPP)
+		ret = ext4fs_find_dirent_linear(diro, name, buf, &dirent);
+
+	free(buf);
+
+	if (ret == -ENOENT)
+		ext4fs_dcache_add(data, diro->ino, name, 0, 0, NULL);
+	if (ret)
+		goto err;
+
+	fdiro->ino = __le32_to_cpu(dirent.inode);
+
+	ret = ext4fs_read_inode(data, fdiro->ino, &fdiro->inode);
+	if (ret)
+		goto err;
+
+	fdiro->inode_read = 1;
+
+	dev_dbg(fs->dev, "iterate >%s<\n", name);
+
+	*ftype = ext4fs_inode_type(&fdiro->inode);
+	*fnode = fdiro;
+
+	ext4fs_dcache_add(data, diro->ino, name, fdiro->ino, *ftype,
+			&fdiro->inode);
+
+	return 0;
+err:
+	free(fdiro);
+
+	return ret;
 }
 
 char *ext4fs_read_symlink(struct ext2fs_node *node)
@@ -518,6 +859,7 @@ int ext4fs_mount(struct ext_filesystem *fs)
 	data->inode = &data->diropen.inode;
 	data->fs = fs;
 	fs->data = data;
+	INIT_LIST_HEAD(&data->dcache_list);
 
 	blksz = EXT2_BLOCK_SIZE(data);
 
@@ -531,6 +873,10 @@ int ext4fs_mount(struct ext_filesystem *fs)
 		goto fail;
 	}
 
+	fs->data->indir1.blkno = -1;
+	fs->data->indir2.blkno = -1;
+	fs->data->indir3.blkno = -1;
+
 	ret = ext4fs_read_inode(data, 2, data->inode);
 	if (ret)
 		goto fail;
@@ -544,6 +890,8 @@ fail:
 
 void ext4fs_umount(struct ext_filesystem *fs)
 {
+	free(fs->data->diropen.extents);
+	ext4fs_dcache_free(fs->data);
 	free(fs->data->indir1.data);
 	free(fs->data->indir2.data);
 	free(fs->data->indir3.data);
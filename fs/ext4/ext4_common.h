@@ -54,5 +54,7 @@ int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 			struct ext2fs_node **foundnode, int *foundtype);
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
+int ext4fs_dirhash(const char *name, int len, int version,
+		const uint32_t *seed, uint32_t *hash);
 
 #endif
@@ -38,115 +38,91 @@
 
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 {
-	if ((node != &node->data->diropen) && (node != currroot))
+	if ((node != &node->data->diropen) && (node != currroot)) {
+		free(node->extents);
 		free(node);
+	}
 }
 
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
  * reads into one potentially more efficient larger sequential read action
+ *
+ * Blocks are mapped a run at a time, so whole extents are read with a
+ * single ext4fs_devread() into the caller's buffer.
  */
 int ext4fs_read_file(struct ext2fs_node *node, int pos,
 		unsigned int len, char *buf)
 {
-	int i;
-	int blockcnt;
 	int log2blocksize = LOG2_EXT2_BLOCK_SIZE(node->data);
-	int blocksize = 1 << (log2blocksize + DISK_SECTOR_BITS);
+	int blockbits = log2blocksize + DISK_SECTOR_BITS;
+	int blocksize = 1 << blockbits;
 	unsigned int filesize = __le32_to_cpu(node->inode.size);
-	int previous_block_number = -1;
+	unsigned int end;
+	long int delayed_next = 0;
 	int delayed_start = 0;
 	int delayed_extent = 0;
 	int delayed_skipfirst = 0;
-	int delayed_next = 0;
 	char *delayed_buf = NULL;
-	short ret;
+	int ret;
 	struct ext_filesystem *fs = node->data->fs;
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len > filesize)
 		len = filesize;
 
-	blockcnt = ((len + pos) + blocksize - 1) / blocksize;
+	end = pos + len;
+
+	while (pos < end) {
+		long int blknr;
+		int nblocks;
+		int skipfirst = pos & (blocksize - 1);
+		unsigned int now;
 
-	for (i = pos / blocksize; i < blockcnt; i++) {
-		int blknr;
-		int blockoff = pos % blocksize;
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr = read_allocated_block(node, i);
+		blknr = read_allocated_block(node, pos >> blockbits, &nblocks);
 		if (blknr < 0)
 			return blknr;
 
-		blknr = blknr << log2blocksize;
+		now = end - pos;
+		if (((u64)nblocks << blockbits) < (u64)now + skipfirst)
+			now = (nblocks << blockbits) - skipfirst;
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) % blocksize;
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
-
-		/* First block. */
-		if (i == pos / blocksize) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
-		if (blknr) {
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> SECTOR_BITS;
-				} else {	/* spill */
-					ret = ext4fs_devread(fs, delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (ret)
-						return ret;
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> SECTOR_BITS);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_skipfirst = skipfirst;
-				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> SECTOR_BITS);
-			}
+		if (blknr && delayed_extent && blknr == delayed_next) {
+			delayed_extent += now;
+			delayed_next = blknr + nblocks;
 		} else {
-			if (previous_block_number != -1) {
+			if (delayed_extent) {
 				/* spill */
 				ret = ext4fs_devread(fs, delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
+						delayed_skipfirst,
+						delayed_extent, delayed_buf);
 				if (ret)
 					return ret;
-				previous_block_number = -1;
+				delayed_extent = 0;
+			}
+
+			if (blknr) {
+				delayed_start = blknr << log2blocksize;
+				delayed_extent = now;
+				delayed_skipfirst = skipfirst;
+				delayed_buf = buf;
+				delayed_next = blknr + nblocks;
+			} else {
+				memset(buf, 0, now);
 			}
-			memset(buf, 0, blocksize - skipfirst);
 		}
-		buf += blocksize - skipfirst;
+
+		pos += now;
+		buf += now;
 	}
-	if (previous_block_number != -1) {
+
+	if (delayed_extent) {
 		/* spill */
-		ret = ext4fs_devread(fs, delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
+		ret = ext4fs_devread(fs, delayed_start, delayed_skipfirst,
+				delayed_extent, delayed_buf);
 		if (ret)
 			return ret;
-		previous_block_number = -1;
 	}
 
 	return len;
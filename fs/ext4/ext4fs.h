@@ -26,8 +26,13 @@
 
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
+#define EXT4_EXT_INIT_MAX_LEN		(1 << 15) /* longer are unwritten */
+#define EXT4_MAX_EXTENT_DEPTH		5
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
+#define EXT4_FEATURE_INCOMPAT_64BIT	0x0080
+#define EXT4_FEATURE_COMPAT_DIR_INDEX	0x0020
+#define EXT4_INDEX_FL			0x00001000 /* hash-indexed directory */
 #define EXT4_INDIRECT_BLOCKS		12
 
 #define EXT4_BG_INODE_UNINIT		0x0001
@@ -63,6 +68,42 @@ struct ext4_extent_idx {
 	__u16	ei_unused;
 };
 
+/*
+ * Hash-indexed directories (htree). The root in the first directory
+ * block starts with the "." and ".." entries, followed by dx_root_info
+ * and the dx_entry array. The first entry holds the count and limit
+ * instead of a hash. Index nodes are a single empty dirent spanning the
+ * block followed by the entries.
+ */
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+#define EXT4_HTREE_EOF_32BIT		0x7fffffff
+#define EXT4_HTREE_LEVEL		2
+
+struct dx_root_info {
+	__le32	reserved_zero;
+	u8	hash_version;
+	u8	info_length;	/* 8 */
+	u8	indirect_levels;
+	u8	unused_flags;
+};
+
+struct dx_entry {
+	__le32	hash;
+	__le32	block;
+};
+
+struct dx_countlimit {
+	__le16	limit;
+	__le16	count;
+};
+
 /* Each block (leaves and indexes), even inode-stored has header. */
 struct ext4_extent_header {
 	__le16	eh_magic;	/* probably will support different formats */
@@ -122,6 +163,7 @@ void ext4fs_umount(struct ext_filesystem *fs);
 char *ext4fs_read_symlink(struct ext2fs_node *node);
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot);
 int ext4fs_devread(struct ext_filesystem *fs, int sector, int byte_offset, int byte_len, char *buf);
-long int read_allocated_block(struct ext2fs_node *node, int fileblock);
+long int read_allocated_block(struct ext2fs_node *node, int fileblock,
+		int *nblocks);
 
 #endif
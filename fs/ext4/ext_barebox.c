@@ -109,13 +109,15 @@ static DIR *ext_opendir(struct device_d *dev, const char *pathname)
 
 	ext4_dir->dir.priv = ext4_dir;
 
-	ret = ext4fs_read_inode(ext4_dir->dirnode->data, ext4_dir->dirnode->ino,
-			&ext4_dir->dirnode->inode);
-	if (ret) {
-		ext4fs_free_node(ext4_dir->dirnode, &fs->data->diropen);
-		free(ext4_dir);
-
-		return NULL;
+	if (!ext4_dir->dirnode->inode_read) {
+		ret = ext4fs_read_inode(ext4_dir->dirnode->data,
+				ext4_dir->dirnode->ino, &ext4_dir->dirnode->inode);
+		if (ret) {
+			ext4fs_free_node(ext4_dir->dirnode, &fs->data->diropen);
+			free(ext4_dir);
+
+			return NULL;
+		}
 	}
 
 	return &ext4_dir->dir;
@@ -182,9 +184,11 @@ static int ext_stat(struct device_d *dev, const char *filename, struct stat *s)
 	if (status)
 		return -ENOENT;
 
-	ret = ext4fs_read_inode(node->data, node->ino, &node->inode);
-	if (ret)
-		return ret;
+	if (!node->inode_read) {
+		ret = ext4fs_read_inode(node->data, node->ino, &node->inode);
+		if (ret)
+			return ret;
+	}
 
 	s->st_size = __le32_to_cpu(node->inode.size);
 	s->st_mode = __le16_to_cpu(node->inode.mode);
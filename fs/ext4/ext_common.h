@@ -116,6 +116,27 @@ struct ext2_sblock {
 	char volume_name[16];
 	char last_mounted_on[64];
 	uint32_t compression_info;
+	uint8_t prealloc_blocks;
+	uint8_t prealloc_dir_blocks;
+	uint16_t reserved_gdt_blocks;
+	uint8_t journal_uuid[16];
+	uint32_t journal_inode;
+	uint32_t journal_dev;
+	uint32_t last_orphan;
+	uint32_t hash_seed[4];
+	uint8_t default_hash_version;
+	uint8_t journal_backup_type;
+	uint16_t descriptor_size;
+	uint32_t default_mount_options;
+	uint32_t first_meta_block_group;
+	uint32_t mkfs_time;
+	uint32_t journal_blocks[17];
+	uint32_t total_blocks_high;
+	uint32_t reserved_blocks_high;
+	uint32_t free_blocks_high;
+	uint16_t min_extra_inode_size;
+	uint16_t want_extra_inode_size;
+	uint32_t flags;
 };
 
 struct ext2_block_group {
@@ -169,11 +190,24 @@ struct ext2_dirent {
 	uint8_t filetype;
 };
 
+/* A decoded ext4 extent, start is 0 for unwritten extents */
+struct ext4fs_extent_map {
+	uint32_t block;
+	uint32_t len;
+	uint64_t start;
+};
+
 struct ext2fs_node {
 	struct ext2_data *data;
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+
+	/* extent tree of the inode, decoded on first read */
+	struct ext4fs_extent_map *extents;
+	int num_extents;
+	int last_extent;
+	int extents_read;
 };
 
 struct ext4fs_indir_block {
@@ -182,6 +216,23 @@ struct ext4fs_indir_block {
 	uint32_t *data;
 };
 
+#define EXT4_DCACHE_HASH_BITS	6
+#define EXT4_DCACHE_MAX		256
+
+/*
+ * A cached directory lookup, ino is 0 for names not found. The inode
+ * of found entries is cached along.
+ */
+struct ext4fs_dentry {
+	struct hlist_node hash;
+	struct list_head list;
+	int dir;
+	int ino;
+	int type;
+	struct ext2_inode inode;
+	char name[];
+};
+
 /* Information about a "mounted" ext2 filesystem. */
 struct ext2_data {
 	struct ext2_sblock sblock;
@@ -189,6 +240,11 @@ struct ext2_data {
 	struct ext2fs_node diropen;
 	struct ext_filesystem *fs;
 	struct ext4fs_indir_block indir1, indir2, indir3;
+
+	/* dentry cache, lives until umount */
+	struct hlist_head dcache[1 << EXT4_DCACHE_HASH_BITS];
+	struct list_head dcache_list;
+	int dcache_num;
 };
 
 extern unsigned long part_offset;
@@ -32,10 +32,10 @@
 #include <init.h>
 #include <linux/stat.h>
 #include <linux/err.h>
-#include <kfifo.h>
 #include <linux/sizes.h>
 #include <byteorder.h>
 #include <globalvar.h>
+#include <magicvar.h>
 
 #include "parseopt.h"
 
@@ -58,6 +58,7 @@
 #define NFSPROC3_READLINK	5
 #define NFSPROC3_READ		6
 #define NFSPROC3_READDIR	16
+#define NFSPROC3_FSINFO		19
 
 #define NFS3_FHSIZE      64
 #define NFS3_COOKIEVERFSIZE	8
@@ -104,6 +105,7 @@
 
 static void *nfs_packet;
 static int nfs_len;
+static void *nfs_frame;		/* claimed receive buffer holding nfs_packet */
 
 struct rpc_call {
 	uint32_t id;
@@ -128,6 +130,23 @@ struct rpc_reply {
 #define NFS_TIMEOUT	(2 * SECOND)
 #define NFS_MAX_RESEND	5
 
+/*
+ * Without IP fragment reassembly a READ reply has to fit into a single
+ * ethernet frame: rpc_reply, status, post_op_attr, count, eof and data
+ * length are in front of the data.
+ */
+#define NFS_READ_OVERHEAD	(sizeof(struct rpc_reply) + 4 + 88 + 12)
+#define NFS_MAX_RSIZE		((1500 - sizeof(struct iphdr) - \
+				  sizeof(struct udphdr) - \
+				  NFS_READ_OVERHEAD) & ~3)
+#define NFS_DEFAULT_RSIZE	1024
+
+#define NFS_READAHEAD		8	/* default number of READs in flight */
+#define NFS_MAX_READAHEAD	32
+
+/* READ calls have their own xid space so replies can't be mistaken */
+#define NFS_READ_XID		0x80000000
+
 struct nfs_priv {
 	struct net_connection *con;
 	IPaddr_t server;
@@ -135,18 +154,47 @@ struct nfs_priv {
 	uint16_t mount_port;
 	uint16_t nfs_port;
 	uint32_t rpc_id;
+	uint32_t read_id;
+	uint32_t rsize;
 	uint32_t rootfh_len;
 	char rootfh[NFS3_FHSIZE];
+	struct list_head readers;	/* files with READs in flight */
+};
+
+#define NFS_SLOT_PENDING	1
+#define NFS_SLOT_DONE		2
+
+/* A READ call of the sequential prefetch and its reply */
+struct nfs_read_slot {
+	int state;
+	uint32_t id;
+	uint64_t offset;
+	uint32_t len;
+	uint32_t rlen;
+	int eof;
+	int err;
+	int tries;
+	uint64_t start;
+	void *data;
+	void *packet;		/* claimed receive buffer */
+	void *copy;
 };
 
 struct file_priv {
-	struct kfifo *fifo;
 	void *buf;
 	uint32_t filefh_len;
 	char filefh[NFS3_FHSIZE];
 	struct nfs_priv *npriv;
+	loff_t size;
+	struct nfs_read_slot *slots;	/* ring of READs, oldest first */
+	int nslots;
+	int head;
+	int count;
+	struct list_head list;
 };
 
+static int nfs_readahead = NFS_READAHEAD;
+
 static uint64_t nfs_timer_start;
 
 static int nfs_state;
@@ -375,21 +423,28 @@ static int rpc_check_reply(unsigned char *pkt,
 }
 
 /*
- * rpc_req - synchronous RPC request
+ * Give the receive buffer of the last reply back to the network stack
  */
-static int rpc_req(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
-		uint32_t *data, int datalen)
+static void nfs_release_reply(void)
+{
+	if (nfs_frame)
+		net_rx_release(nfs_frame);
+
+	nfs_frame = NULL;
+	nfs_packet = NULL;
+}
+
+/*
+ * rpc_send - send a RPC call without waiting for the reply
+ */
+static int rpc_send(struct nfs_priv *npriv, uint32_t id, int rpc_prog,
+		int rpc_proc, uint32_t *data, int datalen)
 {
 	struct rpc_call pkt;
 	unsigned short dport;
-	int ret;
 	unsigned char *payload = net_udp_get_payload(npriv->con);
-	int nfserr;
-	int tries = 0;
 
-	npriv->rpc_id++;
-
-	pkt.id = hton32(npriv->rpc_id);
+	pkt.id = hton32(id);
 	pkt.type = hton32(MSG_CALL);
 	pkt.rpcvers = hton32(2);	/* use RPC version 2 */
 	pkt.prog = hton32(rpc_prog);
@@ -413,14 +468,30 @@ static int rpc_req(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
 
 	npriv->con->udp->uh_dport = hton16(dport);
 
-again:
-	ret = net_udp_send(npriv->con,
+	return net_udp_send(npriv->con,
 			sizeof(pkt) + datalen * sizeof(uint32_t));
+}
+
+/*
+ * rpc_req - synchronous RPC request
+ */
+static int rpc_req(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
+		uint32_t *data, int datalen)
+{
+	int ret;
+	int nfserr;
+	int tries = 0;
+
+	npriv->rpc_id++;
+
+again:
+	ret = rpc_send(npriv, npriv->rpc_id, rpc_prog, rpc_proc,
+			data, datalen);
 
 	nfs_timer_start = get_time_ns();
 
 	nfs_state = STATE_START;
-	nfs_packet = NULL;
+	nfs_release_reply();
 
 	while (nfs_state != STATE_DONE) {
 		if (ctrlc()) {
@@ -646,6 +717,54 @@ static int nfs_mount_req(struct nfs_priv *npriv)
 	return 0;
 }
 
+/*
+ * nfs_fsinfo_req - Limit the read size to what the server supports
+ */
+static int nfs_fsinfo_req(struct nfs_priv *npriv)
+{
+	uint32_t data[1024];
+	uint32_t *p;
+	int len;
+	int ret;
+	uint32_t rtmax;
+
+	/*
+	 * struct FSINFO3args {
+	 * 	nfs_fh3 fsroot;
+	 * };
+	 *
+	 * struct FSINFO3resok {
+	 * 	post_op_attr obj_attributes;
+	 * 	uint32 rtmax;
+	 * 	uint32 rtpref;
+	 * 	uint32 rtmult;
+	 * 	...
+	 * };
+	 */
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	p = nfs_add_fh3(p, npriv->rootfh_len, npriv->rootfh);
+
+	len = p - &(data[0]);
+
+	ret = rpc_req(npriv, PROG_NFS, NFSPROC3_FSINFO, data, len);
+	if (ret)
+		return ret;
+
+	p = nfs_packet + sizeof(struct rpc_reply) + 4;
+
+	p = nfs_read_post_op_attr(p, NULL);
+
+	rtmax = ntoh32(net_read_uint32(p)) & ~3;
+	if (!rtmax)
+		return -EIO;
+
+	npriv->rsize = min(npriv->rsize, rtmax);
+
+	return 0;
+}
+
 /*
  * nfs_umountall_req - Unmount all our NFS Filesystems on the Server
  */
@@ -869,16 +988,13 @@ static void *nfs_readdirattr_req(struct file_priv *priv, struct nfs_dir *dir)
 }
 
 /*
- * nfs_read_req - Read File on NFS Server
+ * nfs_read_send - Send a READ call for a prefetch slot
  */
-static int nfs_read_req(struct file_priv *priv, uint64_t offset,
-		uint32_t readlen)
+static int nfs_read_send(struct file_priv *priv, struct nfs_read_slot *slot)
 {
 	uint32_t data[1024];
 	uint32_t *p;
 	int len;
-	int ret;
-	uint32_t rlen, eof;
 
 	/*
 	 * struct READ3args {
@@ -886,7 +1002,34 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	offset3 offset;
 	 * 	count3 count;
 	 * };
-	 *
+	 */
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	p = nfs_add_fh3(p, priv->filefh_len, priv->filefh);
+	p = nfs_add_uint64(p, slot->offset);
+	p = nfs_add_uint32(p, slot->len);
+
+	len = p - &(data[0]);
+
+	slot->start = get_time_ns();
+
+	return rpc_send(priv->npriv, slot->id, PROG_NFS, NFSPROC3_READ,
+			data, len);
+}
+
+/*
+ * nfs_read_reply - Handle the reply to a READ call
+ */
+static void nfs_read_reply(struct nfs_read_slot *slot, char *packet,
+		unsigned char *pkt, unsigned len)
+{
+	struct rpc_reply rpc;
+	uint32_t *p;
+	uint32_t rlen;
+	int nfserr;
+
+	/*
 	 * struct READ3resok {
 	 * 	post_op_attr file_attributes;
 	 * 	count3 count;
@@ -905,20 +1048,20 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	READ3resfail resfail;
 	 * };
 	 */
-	p = &(data[0]);
-	p = rpc_add_credentials(p);
-
-	p = nfs_add_fh3(p, priv->filefh_len, priv->filefh);
-	p = nfs_add_uint64(p, offset);
-	p = nfs_add_uint32(p, readlen);
-
-	len = p - &(data[0]);
+	slot->state = NFS_SLOT_DONE;
 
-	ret = rpc_req(priv->npriv, PROG_NFS, NFSPROC3_READ, data, len);
-	if (ret)
-		return ret;
+	memcpy(&rpc, pkt, sizeof(rpc));
+	if (rpc.rstatus || rpc.verifier || rpc.astatus) {
+		slot->err = -EINVAL;
+		return;
+	}
 
-	p = nfs_packet + sizeof(struct rpc_reply) + 4;
+	p = (uint32_t *)(pkt + sizeof(struct rpc_reply));
+	nfserr = ntoh32(net_read_uint32(p++));
+	if (nfserr) {
+		slot->err = -nfserr;
+		return;
+	}
 
 	p = nfs_read_post_op_attr(p, NULL);
 
@@ -927,7 +1070,7 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	/* skip over count */
 	p += 1;
 
-	eof = ntoh32(net_read_uint32(p));
+	slot->eof = ntoh32(net_read_uint32(p));
 
 	/*
 	 * skip over eof and count embedded in the representation of data
@@ -935,17 +1078,55 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 */
 	p += 2;
 
-	if (readlen && !rlen && !eof)
-		return -EIO;
+	if (rlen > slot->len || (void *)p + rlen > (void *)pkt + len ||
+			(!rlen && !slot->eof)) {
+		slot->err = -EIO;
+		return;
+	}
 
-	kfifo_put(priv->fifo, (char *)p, rlen);
+	slot->rlen = rlen;
 
-	return 0;
+	if (net_rx_claim(packet)) {
+		slot->packet = packet;
+		slot->data = p;
+	} else {
+		memcpy(slot->copy, p, rlen);
+		slot->data = slot->copy;
+	}
 }
 
 static void nfs_handler(void *ctx, char *packet, unsigned len)
 {
+	struct nfs_priv *npriv = ctx;
 	char *pkt = net_eth_to_udp_payload(packet);
+	struct file_priv *priv;
+	uint32_t id;
+	int i;
+
+	id = ntoh32(net_read_uint32(pkt));
+	if (id & NFS_READ_XID) {
+		list_for_each_entry(priv, &npriv->readers, list) {
+			for (i = 0; i < priv->nslots; i++) {
+				struct nfs_read_slot *slot = &priv->slots[i];
+
+				if (slot->state == NFS_SLOT_PENDING &&
+						slot->id == id) {
+					nfs_read_reply(slot, packet, pkt,
+						net_eth_to_udplen(packet));
+					return;
+				}
+			}
+		}
+
+		/* reply to a READ we are no longer interested in */
+		return;
+	}
+
+	nfs_release_reply();
+
+	/* keep the reply in the receive buffer until it has been parsed */
+	if (net_rx_claim(packet))
+		nfs_frame = packet;
 
 	nfs_state = STATE_DONE;
 	nfs_packet = pkt;
@@ -1028,10 +1209,41 @@ out:
 	return ERR_PTR(ret);
 }
 
+static void nfs_slot_free(struct nfs_read_slot *slot)
+{
+	if (slot->packet)
+		net_rx_release(slot->packet);
+
+	slot->packet = NULL;
+	slot->data = NULL;
+	slot->state = 0;
+}
+
+/* Drop the oldest READ of the prefetch window */
+static void nfs_read_pop(struct file_priv *priv)
+{
+	nfs_slot_free(&priv->slots[priv->head]);
+	priv->head = (priv->head + 1) % priv->nslots;
+	priv->count--;
+}
+
+static void nfs_read_reset(struct file_priv *priv)
+{
+	while (priv->count)
+		nfs_read_pop(priv);
+}
+
 static void nfs_do_close(struct file_priv *priv)
 {
-	if (priv->fifo)
-		kfifo_free(priv->fifo);
+	int i;
+
+	if (priv->slots) {
+		nfs_read_reset(priv);
+		for (i = 0; i < priv->nslots; i++)
+			free(priv->slots[i].copy);
+		free(priv->slots);
+		list_del(&priv->list);
+	}
 
 	free(priv);
 }
@@ -1140,6 +1352,7 @@ static int nfs_open(struct device_d *dev, FILE *file, const char *filename)
 {
 	struct file_priv *priv;
 	struct stat s;
+	int i;
 
 	priv = nfs_do_stat(dev, filename, &s);
 	if (IS_ERR(priv))
@@ -1148,11 +1361,13 @@ static int nfs_open(struct device_d *dev, FILE *file, const char *filename)
 	file->priv = priv;
 	file->size = s.st_size;
 
-	priv->fifo = kfifo_alloc(1024);
-	if (!priv->fifo) {
-		free(priv);
-		return -ENOMEM;
-	}
+	priv->size = s.st_size;
+	priv->nslots = clamp(nfs_readahead, 1, NFS_MAX_READAHEAD);
+	priv->slots = xzalloc(priv->nslots * sizeof(*priv->slots));
+	for (i = 0; i < priv->nslots; i++)
+		priv->slots[i].copy = xmalloc(priv->npriv->rsize);
+
+	list_add(&priv->list, &priv->npriv->readers);
 
 	return 0;
 }
@@ -1172,28 +1387,151 @@ static int nfs_write(struct device_d *_dev, FILE *file, const void *inbuf,
 	return -ENOSYS;
 }
 
-static int nfs_read(struct device_d *dev, FILE *file, void *buf, size_t insize)
+/*
+ * Keep the prefetch window filled with READ calls for the data following
+ * @pos. At least one call is sent, even beyond the size the file had when
+ * it was opened.
+ */
+static int nfs_read_fill(struct file_priv *priv, loff_t pos)
 {
-	struct file_priv *priv = file->priv;
+	struct nfs_priv *npriv = priv->npriv;
+	struct nfs_read_slot *slot;
+	int ret;
 
-	if (insize > 1024)
-		insize = 1024;
+	while (priv->count < priv->nslots) {
+		if (priv->count) {
+			slot = &priv->slots[(priv->head + priv->count - 1) %
+					priv->nslots];
+			pos = slot->offset + slot->len;
+			if (pos >= priv->size)
+				break;
+		}
 
-	if (insize && !kfifo_len(priv->fifo)) {
-		int ret = nfs_read_req(priv, file->pos, insize);
+		slot = &priv->slots[(priv->head + priv->count) % priv->nslots];
+		slot->state = NFS_SLOT_PENDING;
+		slot->id = NFS_READ_XID | npriv->read_id++;
+		slot->offset = pos;
+		slot->len = npriv->rsize;
+		slot->rlen = 0;
+		slot->eof = 0;
+		slot->err = 0;
+		slot->tries = 0;
+		priv->count++;
+
+		ret = nfs_read_send(priv, slot);
 		if (ret)
 			return ret;
 	}
 
-	return kfifo_get(priv->fifo, buf, insize);
+	return 0;
 }
 
-static loff_t nfs_lseek(struct device_d *dev, FILE *file, loff_t pos)
+/*
+ * Wait for the reply to the oldest READ, resending the calls which
+ * timed out in the meantime.
+ */
+static int nfs_read_wait(struct file_priv *priv)
+{
+	struct nfs_read_slot *slot;
+	int i;
+
+	while (priv->slots[priv->head].state == NFS_SLOT_PENDING) {
+		if (ctrlc())
+			return -EINTR;
+
+		net_poll();
+
+		for (i = 0; i < priv->count; i++) {
+			slot = &priv->slots[(priv->head + i) % priv->nslots];
+
+			if (slot->state != NFS_SLOT_PENDING ||
+					!is_timeout(slot->start, NFS_TIMEOUT))
+				continue;
+
+			if (++slot->tries == NFS_MAX_RESEND)
+				return -ETIMEDOUT;
+
+			nfs_read_send(priv, slot);
+		}
+	}
+
+	return priv->slots[priv->head].err;
+}
+
+/*
+ * Return the slot holding the data at @pos or NULL at the end of the file
+ */
+static struct nfs_read_slot *nfs_read_slot(struct file_priv *priv, loff_t pos)
+{
+	struct nfs_read_slot *head;
+	int ret;
+
+	while (1) {
+		/*
+		 * Drop the READs for data before @pos, start over when @pos
+		 * is not within the window.
+		 */
+		while (priv->count) {
+			head = &priv->slots[priv->head];
+			if (pos < head->offset) {
+				nfs_read_reset(priv);
+				break;
+			}
+			if (pos < head->offset + head->len)
+				break;
+			nfs_read_pop(priv);
+		}
+
+		ret = nfs_read_fill(priv, pos);
+		if (!ret)
+			ret = nfs_read_wait(priv);
+		if (ret) {
+			nfs_read_reset(priv);
+			return ERR_PTR(ret);
+		}
+
+		head = &priv->slots[priv->head];
+		if (pos < head->offset + head->rlen)
+			return head;
+
+		if (head->eof)
+			return NULL;
+
+		/* short read, ask for the rest */
+		nfs_read_reset(priv);
+	}
+}
+
+static int nfs_read(struct device_d *dev, FILE *file, void *buf, size_t insize)
 {
 	struct file_priv *priv = file->priv;
+	struct nfs_read_slot *slot;
+	loff_t pos = file->pos;
+	size_t outsize = 0, now, offset;
+
+	while (insize) {
+		slot = nfs_read_slot(priv, pos);
+		if (IS_ERR(slot))
+			return outsize ? outsize : PTR_ERR(slot);
+		if (!slot)
+			break;
 
+		offset = pos - slot->offset;
+		now = min_t(size_t, insize, slot->rlen - offset);
+		memcpy(buf, slot->data + offset, now);
+
+		buf += now;
+		insize -= now;
+		outsize += now;
+		pos += now;
+	}
+
+	return outsize;
+}
+
+static loff_t nfs_lseek(struct device_d *dev, FILE *file, loff_t pos)
+{
 	file->pos = pos;
-	kfifo_reset(priv->fifo);
 
 	return file->pos;
 }
@@ -1330,6 +1668,7 @@ static int nfs_probe(struct device_d *dev)
 	struct nfs_priv *npriv = xzalloc(sizeof(struct nfs_priv));
 	char *tmp = xstrdup(fsdev->backingstore);
 	char *path;
+	unsigned short rsize;
 	int ret;
 
 	dev->priv = npriv;
@@ -1350,6 +1689,8 @@ static int nfs_probe(struct device_d *dev)
 
 	debug("nfs: server: %s path: %s\n", tmp, npriv->path);
 
+	INIT_LIST_HEAD(&npriv->readers);
+
 	npriv->con = net_udp_new(npriv->server, SUNRPC_PORT, nfs_handler, npriv);
 	if (IS_ERR(npriv->con)) {
 		ret = PTR_ERR(npriv->con);
@@ -1387,6 +1728,15 @@ static int nfs_probe(struct device_d *dev)
 		goto err2;
 	}
 
+	rsize = NFS_MAX_RSIZE;
+	parseopt_hu(fsdev->options, "rsize", &rsize);
+	npriv->rsize = clamp_t(uint32_t, rsize & ~3, 4, NFS_MAX_RSIZE);
+
+	ret = nfs_fsinfo_req(npriv);
+	if (ret)
+		npriv->rsize = min_t(uint32_t, npriv->rsize, NFS_DEFAULT_RSIZE);
+	debug("nfs rsize: %u\n", npriv->rsize);
+
 	nfs_set_rootarg(npriv, fsdev);
 
 	free(tmp);
@@ -1444,7 +1794,11 @@ static int nfs_init(void)
 	rootnfsopts = xstrdup("v3,tcp");
 
 	globalvar_add_simple_string("linux.rootnfsopts", &rootnfsopts);
+	globalvar_add_simple_int("nfs.readahead", &nfs_readahead, "%d");
 
 	return register_fs_driver(&nfs_driver);
 }
 coredevice_initcall(nfs_init);
+
+BAREBOX_MAGICVAR_NAMED(global_nfs_readahead, global.nfs.readahead,
+		"Number of READ calls kept in flight when reading NFS files");
@@ -31,7 +31,10 @@
 #include <linux/stat.h>
 #include <linux/err.h>
 #include <kfifo.h>
+#include <globalvar.h>
+#include <magicvar.h>
 #include <linux/sizes.h>
+#include <linux/log2.h>
 
 #define TFTP_PORT	13991	/* TFTP board used by dboard */
 
@@ -66,8 +69,27 @@
 #define TFTP_BLOCK_SIZE		512	/* default TFTP block size */
 #define TFTP_FIFO_SIZE		4096
 
+/* largest block size which fits into a single ethernet frame */
+#define TFTP_MTU_BLOCK_SIZE	(1500 - sizeof(struct iphdr) - \
+				 sizeof(struct udphdr) - 4)
+
+#define TFTP_WINDOW_SIZE	16	/* default RFC 7440 window size */
+#define TFTP_MAX_WINDOW_SIZE	64
+
 #define TFTP_ERR_RESEND	1
 
+/*
+ * A received data block. If the receive buffer could be claimed from the
+ * network stack the data is read directly from it, otherwise it is copied.
+ */
+struct tftp_block {
+	uint16_t block;
+	int len;
+	void *data;		/* payload, NULL if the slot is free */
+	void *packet;		/* claimed receive buffer */
+	void *copy;
+};
+
 struct file_priv {
 	struct net_connection *tftp_con;
 	int push;
@@ -83,8 +105,15 @@ struct file_priv {
 	void *buf;
 	int blocksize;
 	int block_requested;
+	int windowsize;
+	struct tftp_block *blocks;	/* received blocks, indexed by number */
+	int nblocks;
+	uint16_t read_block;		/* next block to be read */
+	int read_offset;
 };
 
+static int tftp_window_size = TFTP_WINDOW_SIZE;
+
 struct tftp_priv {
 	IPaddr_t server;
 };
@@ -114,6 +143,28 @@ static int tftp_truncate(struct device_d *dev, FILE *f, ulong size)
 	return 0;
 }
 
+/*
+ * With a window size > 1 (RFC 7440) a block is only acknowledged when
+ * the window is complete or after a timeout (block_requested = -1), and
+ * only when there is room for the next window.
+ */
+static int tftp_ack_due(struct file_priv *priv)
+{
+	uint16_t queued = priv->last_block + 1 - priv->read_block;
+
+	if (priv->block == priv->block_requested)
+		return 0;
+
+	if (queued > priv->nblocks - priv->windowsize)
+		return 0;
+
+	if (priv->block_requested < 0)
+		return 1;
+
+	return (uint16_t)(priv->block - priv->block_requested) >=
+		priv->windowsize;
+}
+
 static int tftp_send(struct file_priv *priv)
 {
 	unsigned char *xp;
@@ -142,22 +193,32 @@ static int tftp_send(struct file_priv *priv)
 				"tsize%c"
 				"%d%c"
 				"blksize%c"
-				"1432",
+				"%zu",
 				priv->filename, 0,
 				0,
 				0,
 				TIMEOUT, 0,
 				0,
 				priv->filesize, 0,
-				0);
+				0,
+				TFTP_MTU_BLOCK_SIZE);
 		pkt++;
+		if (priv->state == STATE_RRQ && priv->windowsize > 1) {
+			pkt += sprintf((unsigned char *)pkt,
+					"windowsize%c"
+					"%d",
+					0,
+					priv->windowsize);
+			pkt++;
+		}
 		len = pkt - xp;
 		break;
 
 	case STATE_RDATA:
-		if (priv->block == priv->block_requested)
+		if (!tftp_ack_due(priv))
 			return 0;
 	case STATE_OACK:
+	case STATE_LAST:
 		xp = pkt;
 		s = (uint16_t *)pkt;
 		*s++ = htons(TFTP_ACK);
@@ -242,6 +303,8 @@ static void tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
 			priv->filesize = simple_strtoul(val, NULL, 10);
 		if (!strcmp(opt, "blksize"))
 			priv->blocksize = simple_strtoul(val, NULL, 10);
+		if (!strcmp(opt, "windowsize"))
+			priv->windowsize = simple_strtoul(val, NULL, 10);
 		debug("OACK opt: %s val: %s\n", opt, val);
 		s = val + strlen(val) + 1;
 	}
@@ -252,10 +315,170 @@ static void tftp_timer_reset(struct file_priv *priv)
 	priv->progress_timeout = priv->resend_timeout = get_time_ns();
 }
 
-static void tftp_recv(struct file_priv *priv,
+/*
+ * Set up the buffers for the negotiated transfer parameters. When reading
+ * there is room for two windows of blocks, one being received while the
+ * other is consumed.
+ */
+static int tftp_setup_window(struct file_priv *priv)
+{
+	struct kfifo *fifo;
+	int i;
+
+	if (priv->blocksize < 8 || priv->blocksize > TFTP_MTU_BLOCK_SIZE ||
+			priv->windowsize < 1 ||
+			priv->windowsize > TFTP_MAX_WINDOW_SIZE)
+		return -EINVAL;
+
+	if (priv->push) {
+		fifo = kfifo_alloc(roundup_pow_of_two(2 * priv->blocksize));
+		if (!fifo)
+			return -ENOMEM;
+
+		kfifo_free(priv->fifo);
+		priv->fifo = fifo;
+
+		return 0;
+	}
+
+	/*
+	 * Blocks are stored at their 16 bit block number modulo the number
+	 * of slots. Use a power of two so that the slots stay consecutive
+	 * when the block number wraps around.
+	 */
+	priv->nblocks = roundup_pow_of_two(2 * priv->windowsize);
+	priv->blocks = xzalloc(priv->nblocks * sizeof(*priv->blocks));
+	for (i = 0; i < priv->nblocks; i++)
+		priv->blocks[i].copy = xmalloc(priv->blocksize);
+
+	priv->read_block = 1;
+	priv->read_offset = 0;
+
+	return 0;
+}
+
+static void tftp_block_free(struct tftp_block *b)
+{
+	if (b->packet)
+		net_rx_release(b->packet);
+
+	b->packet = NULL;
+	b->data = NULL;
+}
+
+static void tftp_free_window(struct file_priv *priv)
+{
+	int i;
+
+	if (!priv->blocks)
+		return;
+
+	for (i = 0; i < priv->nblocks; i++) {
+		tftp_block_free(&priv->blocks[i]);
+		free(priv->blocks[i].copy);
+	}
+
+	free(priv->blocks);
+	priv->blocks = NULL;
+}
+
+/*
+ * Handle a data block. Blocks arriving out of order are kept until the
+ * missing blocks have been received. Returns the length of the last block
+ * which became available in order or -1 if none did.
+ */
+static int tftp_put_block(struct file_priv *priv, uint16_t block,
+		void *data, int len, void *packet)
+{
+	struct tftp_block *b;
+	uint16_t ahead = block - priv->last_block;
+
+	if (ahead == 0 || ahead > priv->windowsize)
+		/* Old block or outside of the window; ignore it. */
+		return -1;
+
+	if ((uint16_t)(block - priv->read_block) >= priv->nblocks)
+		/* No room, the server will send it again */
+		return -1;
+
+	b = &priv->blocks[block % priv->nblocks];
+	if (!b->data) {
+		b->block = block;
+		b->len = len;
+
+		if (net_rx_claim(packet)) {
+			b->packet = packet;
+			b->data = data;
+		} else {
+			memcpy(b->copy, data, len);
+			b->data = b->copy;
+		}
+	}
+
+	if (ahead > 1) {
+		/*
+		 * Last block of the window but some are missing, let the
+		 * server restart at the first missing block.
+		 */
+		if ((uint16_t)(block - priv->block_requested) ==
+				priv->windowsize)
+			priv->block_requested = -1;
+
+		return -1;
+	}
+
+	while (1) {
+		priv->last_block = block;
+		priv->block = block;
+
+		len = b->len;
+		if (len < priv->blocksize)
+			return len;
+
+		block++;
+		b = &priv->blocks[block % priv->nblocks];
+		if (!b->data || b->block != block)
+			return len;
+	}
+}
+
+/*
+ * Copy the blocks received in order to the reader, giving the receive
+ * buffers back to the network stack once they are consumed.
+ */
+static size_t tftp_get_data(struct file_priv *priv, void *buf, size_t size)
+{
+	struct tftp_block *b;
+	size_t now, outsize = 0;
+
+	if (!priv->blocks)
+		return 0;
+
+	while (size && priv->read_block != (uint16_t)(priv->last_block + 1)) {
+		b = &priv->blocks[priv->read_block % priv->nblocks];
+
+		now = min_t(size_t, size, b->len - priv->read_offset);
+		memcpy(buf, b->data + priv->read_offset, now);
+		buf += now;
+		size -= now;
+		outsize += now;
+		priv->read_offset += now;
+
+		if (priv->read_offset == b->len) {
+			tftp_block_free(b);
+			priv->read_block++;
+			priv->read_offset = 0;
+		}
+	}
+
+	return outsize;
+}
+
+static void tftp_recv(struct file_priv *priv, char *packet,
 			uint8_t *pkt, unsigned len, uint16_t uh_sport)
 {
-	uint16_t opcode;
+	uint16_t opcode, block;
+	int ret;
 
 	/* according to RFC1350 minimal tftp packet length is 4 bytes */
 	if (len < 4)
@@ -297,9 +520,30 @@ static void tftp_recv(struct file_priv *priv,
 		break;
 
 	case TFTP_OACK:
+		if (priv->state == STATE_OACK) {
+			/* our ACK got lost, send it again */
+			tftp_send(priv);
+			break;
+		}
+
+		if (priv->state != STATE_RRQ && priv->state != STATE_WRQ)
+			break;
+
+		/* no windowing unless the server acknowledges it */
+		priv->windowsize = 1;
+
 		tftp_parse_oack(priv, pkt, len);
 		priv->tftp_con->udp->uh_dport = uh_sport;
 
+		if (priv->push)
+			priv->windowsize = 1;
+
+		priv->err = tftp_setup_window(priv);
+		if (priv->err) {
+			priv->state = STATE_DONE;
+			break;
+		}
+
 		if (priv->push) {
 			/* send first block */
 			priv->state = STATE_WDATA;
@@ -314,7 +558,19 @@ static void tftp_recv(struct file_priv *priv,
 		break;
 	case TFTP_DATA:
 		len -= 2;
-		priv->block = ntohs(*(uint16_t *)pkt);
+		block = ntohs(*(uint16_t *)pkt);
+
+		if (priv->state == STATE_RRQ) {
+			/* no OACK, the server doesn't support options */
+			priv->windowsize = 1;
+			priv->blocksize = TFTP_BLOCK_SIZE;
+
+			priv->err = tftp_setup_window(priv);
+			if (priv->err) {
+				priv->state = STATE_DONE;
+				break;
+			}
+		}
 
 		if (priv->state == STATE_RRQ || priv->state == STATE_OACK) {
 			/* first block received */
@@ -322,29 +578,31 @@ static void tftp_recv(struct file_priv *priv,
 			priv->tftp_con->udp->uh_dport = uh_sport;
 			priv->last_block = 0;
 
-			if (priv->block != 1) {	/* Assertion */
+			if (block != 1 && priv->windowsize == 1) {	/* Assertion */
 				printf("error: First block is not block 1 (%d)\n",
-					priv->block);
+					block);
 				priv->err = -EINVAL;
 				priv->state = STATE_DONE;
 				break;
 			}
 		}
 
-		if (priv->block == priv->last_block)
-			/* Same block again; ignore it. */
+		if (priv->state != STATE_RDATA || len > priv->blocksize)
 			break;
 
-		priv->last_block = priv->block;
+		ret = tftp_put_block(priv, block, pkt + 2, len, packet);
+		if (ret < 0)
+			break;
 
 		tftp_timer_reset(priv);
 
-		kfifo_put(priv->fifo, pkt + 2, len);
-
-		if (len < priv->blocksize) {
+		if (ret < priv->blocksize) {
+			priv->state = STATE_LAST;
 			tftp_send(priv);
 			priv->err = 0;
 			priv->state = STATE_DONE;
+		} else {
+			tftp_send(priv);
 		}
 
 		break;
@@ -375,7 +633,8 @@ static void tftp_handler(void *ctx, char *packet, unsigned len)
 	struct udphdr *udp = net_eth_to_udphdr(packet);
 
 	(void)len;
-	tftp_recv(priv, pkt, net_eth_to_udplen(packet), udp->uh_sport);
+	tftp_recv(priv, packet, pkt, net_eth_to_udplen(packet),
+			udp->uh_sport);
 }
 
 static struct file_priv *tftp_do_open(struct device_d *dev,
@@ -416,11 +675,14 @@ static struct file_priv *tftp_do_open(struct device_d *dev,
 	priv->filename = filename;
 	priv->blocksize = TFTP_BLOCK_SIZE;
 	priv->block_requested = -1;
+	priv->windowsize = clamp(tftp_window_size, 1, TFTP_MAX_WINDOW_SIZE);
 
-	priv->fifo = kfifo_alloc(TFTP_FIFO_SIZE);
-	if (!priv->fifo) {
-		ret = -ENOMEM;
-		goto out;
+	if (priv->push) {
+		priv->fifo = kfifo_alloc(TFTP_FIFO_SIZE);
+		if (!priv->fifo) {
+			ret = -ENOMEM;
+			goto out;
+		}
 	}
 
 	priv->tftp_con = net_udp_new(tpriv->server, TFTP_PORT, tftp_handler,
@@ -456,7 +718,9 @@ static struct file_priv *tftp_do_open(struct device_d *dev,
 out2:
 	net_unregister(priv->tftp_con);
 out1:
-	kfifo_free(priv->fifo);
+	tftp_free_window(priv);
+	if (priv->fifo)
+		kfifo_free(priv->fifo);
 out:
 	free(priv);
 
@@ -508,7 +772,9 @@ static int tftp_do_close(struct file_priv *priv)
 	}
 
 	net_unregister(priv->tftp_con);
-	kfifo_free(priv->fifo);
+	tftp_free_window(priv);
+	if (priv->fifo)
+		kfifo_free(priv->fifo);
 	free(priv->buf);
 	free(priv);
 
@@ -567,7 +833,7 @@ static int tftp_read(struct device_d *dev, FILE *f, void *buf, size_t insize)
 	debug("%s %zu\n", __func__, insize);
 
 	while (insize) {
-		now = kfifo_get(priv->fifo, buf, insize);
+		now = tftp_get_data(priv, buf, insize);
 		if (priv->state == STATE_DONE)
 			return outsize + now;
 		if (now) {
@@ -576,8 +842,7 @@ static int tftp_read(struct device_d *dev, FILE *f, void *buf, size_t insize)
 			insize -= now;
 		}
 
-		if (TFTP_FIFO_SIZE - kfifo_len(priv->fifo) >= priv->blocksize)
-			tftp_send(priv);
+		tftp_send(priv);
 
 		ret = tftp_poll(priv);
 		if (ret == TFTP_ERR_RESEND)
@@ -662,6 +927,11 @@ static struct fs_driver_d tftp_driver = {
 
 static int tftp_init(void)
 {
+	globalvar_add_simple_int("tftp.windowsize", &tftp_window_size, "%d");
+
 	return register_fs_driver(&tftp_driver);
 }
 coredevice_initcall(tftp_init);
+
+BAREBOX_MAGICVAR_NAMED(global_tftp_windowsize, global.tftp.windowsize,
+		"TFTP window size (RFC 7440) to request, 1 disables windowing");
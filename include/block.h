@@ -6,14 +6,38 @@
 
 struct block_device;
 
+struct block_request {
+	struct block_device *blk;
+	void *buf;
+	int block;
+	int num_blocks;
+	int status;		/* -EINPROGRESS while in flight */
+	struct list_head list;	/* for use by the driver */
+};
+
 struct block_device_ops {
 	int (*read)(struct block_device *, void *buf, int block, int num_blocks);
 	int (*write)(struct block_device *, const void *buf, int block, int num_blocks);
 	int (*flush)(struct block_device *);
+	/* optional asynchronous reads, see block_submit() */
+	int (*submit)(struct block_device *, struct block_request *);
+	int (*complete)(struct block_device *, struct block_request *);
 };
 
 struct chunk;
 
+/*
+ * A read-ahead window. It is read with consecutive requests of at most
+ * max_req_blocks blocks, only one of them in flight at a time.
+ */
+struct block_window {
+	struct block_request req;	/* part of the window in flight */
+	void *buf;
+	int block;
+	int num_blocks;
+	int valid;			/* blocks read so far */
+};
+
 struct block_device {
 	struct device_d *dev;
 	struct list_head list;
@@ -22,9 +46,27 @@ struct block_device {
 	int num_blocks;
 	int rdbufsize;
 	int blkmask;
+	int max_req_blocks;		/* largest request the device accepts */
+
+	struct list_head *cache_sets;	/* LRU list of chunks for each set */
+	int cache_set_bits;		/* log2 of the number of sets */
+	int cache_chunks;		/* overall number of chunks */
+
+	int cache_hits;
+	int cache_misses;
+	int cache_evictions;
 
-	struct list_head buffered_blocks;
-	struct list_head idle_blocks;
+	struct block_window ra[2];	/* read-ahead windows */
+	int ra_cur;			/* window currently read from */
+	int ra_window;			/* current read-ahead window size */
+	int readahead_kb;		/* maximum read-ahead window size */
+	int seq_next;			/* block expected for sequential reads */
+
+	struct param_d *param_cache_chunks;
+	struct param_d *param_cache_hits;
+	struct param_d *param_cache_misses;
+	struct param_d *param_cache_evictions;
+	struct param_d *param_readahead_kb;
 
 	struct cdev cdev;
 };
@@ -39,6 +81,9 @@ int blockdevice_unregister(struct block_device *blk);
 int block_read(struct block_device *blk, void *buf, int block, int num_blocks);
 int block_write(struct block_device *blk, void *buf, int block, int num_blocks);
 
+int block_submit(struct block_device *blk, struct block_request *req);
+int block_complete(struct block_device *blk, struct block_request *req);
+
 static inline int block_flush(struct block_device *blk)
 {
 	return cdev_flush(&blk->cdev);
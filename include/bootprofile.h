@@ -0,0 +1,37 @@
+#ifndef __BOOTPROFILE_H
+#define __BOOTPROFILE_H
+
+enum bootprofile_type {
+	BOOTPROFILE_INITCALL,
+	BOOTPROFILE_PROBE,
+	BOOTPROFILE_DEFERRED,
+	BOOTPROFILE_SCRIPT,
+};
+
+struct bootprofile_event;
+
+#ifdef CONFIG_BOOTPROFILE
+struct bootprofile_event *bootprofile_start(enum bootprofile_type type,
+		const char *fmt, ...) __attribute__ ((format(__printf__, 2, 3)));
+void bootprofile_end(struct bootprofile_event *event, int result);
+void bootprofile_stop(void);
+void bootprofile_print(uint64_t threshold_ns);
+int bootprofile_export(const char *filename);
+#else
+static inline struct bootprofile_event *bootprofile_start(
+		enum bootprofile_type type, const char *fmt, ...)
+{
+	return NULL;
+}
+
+static inline void bootprofile_end(struct bootprofile_event *event,
+		int result)
+{
+}
+
+static inline void bootprofile_stop(void)
+{
+}
+#endif
+
+#endif /* __BOOTPROFILE_H */
@@ -26,6 +26,7 @@ static inline uint32_t cyc2ns(struct clocksource *cs, uint64_t cycles)
 int init_clock(struct clocksource *);
 
 uint64_t get_time_ns(void);
+bool clocksource_available(void);
 
 void clocks_calc_mult_shift(uint32_t *mult, uint32_t *shift, uint32_t from, uint32_t to, uint32_t maxsec);
 
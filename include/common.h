@@ -76,6 +76,8 @@ void	mdelay (unsigned long);
 /* lib_generic/crc32.c */
 uint32_t crc32(uint32_t, const void*, unsigned int);
 uint32_t crc32_no_comp(uint32_t, const void*, unsigned int);
+int crc32_register_accel(uint32_t (*fn)(uint32_t crc, const void *buf,
+		unsigned int len));
 int file_crc(char *filename, ulong start, ulong size, ulong *crc,
 		    ulong *total);
 
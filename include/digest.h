@@ -63,6 +63,7 @@ struct digest {
 int digest_algo_register(struct digest_algo *d);
 void digest_algo_unregister(struct digest_algo *d);
 void digest_algo_prints(const char *prefix);
+int digest_algo_benchmark(const char *name, uint64_t duration);
 
 struct digest *digest_alloc(const char *name);
 void digest_free(struct digest *d);
@@ -16,6 +16,10 @@
 
 #define DMA_ADDRESS_BROKEN	NULL
 
+#ifndef DMA_ALIGNMENT
+#define DMA_ALIGNMENT	8
+#endif
+
 #ifndef dma_alloc
 static inline void *dma_alloc(size_t size)
 {
@@ -79,6 +79,8 @@ struct device_d {
 
 	const struct platform_device_id *id_entry;
 	struct device_node *device_node;
+	/* node whose compatibles are indexed, see of_device_index_add() */
+	struct device_node *of_compat_node;
 
 	const struct of_device_id *of_id_entry;
 
@@ -88,6 +90,7 @@ struct device_d {
 	 * when the driver should actually detect client devices
 	 */
 	int     (*detect) (struct device_d *);
+	int     detecting;	/* detect() is running, see device_detect() */
 };
 
 /** @brief Describes a driver present in the system */
@@ -134,6 +137,13 @@ int device_probe(struct device_d *dev);
 /* detect devices attached to this device (cards, disks,...) */
 int device_detect(struct device_d *dev);
 int device_detect_by_name(const char *devname);
+#ifdef CONFIG_DEVICE_DETECT_BACKGROUND
+void device_detect_background(void);
+#else
+static inline void device_detect_background(void)
+{
+}
+#endif
 
 /* Unregister a device. This function can fail, e.g. when the device
  * has children.
@@ -457,6 +467,7 @@ int devfs_remove(struct cdev *);
 int cdev_find_free_index(const char *);
 struct cdev *device_find_partition(struct device_d *dev, const char *name);
 struct cdev *cdev_by_name(const char *filename);
+struct cdev *cdev_by_name_detect(const char *name);
 struct cdev *cdev_by_device_node(struct device_node *node);
 struct cdev *cdev_open(const char *name, unsigned long flags);
 int cdev_do_open(struct cdev *, unsigned long flags);
@@ -245,6 +245,7 @@ struct uimage_handle {
 	int nb_data_entries;
 	size_t data_offset;
 	int fd;
+	int verify_on_load;	/* check data crc while loading single images */
 };
 
 #define UIMAGE_INVALID_ADDRESS	(~0)
@@ -221,6 +221,18 @@ struct mtd_info {
 	struct mtd_info *master;
 	loff_t master_offset;
 
+	/* bad block status cache of a master device, see mtd_block_isbad() */
+	unsigned long *bb_known;
+	unsigned long *bb_bad;
+	/* incremented whenever a cached bad block status changes */
+	unsigned int bb_generation;
+	/*
+	 * Devices made of other devices (i.e. mtdconcat) don't cache the bad
+	 * block status, as their parts can be marked bad directly. They
+	 * derive their generation from the parts instead.
+	 */
+	unsigned int (*get_bb_generation)(struct mtd_info *mtd);
+
 	struct list_head partitions;
 	struct list_head partitions_entry;
 
@@ -251,6 +263,17 @@ static inline int mtd_can_have_bb(const struct mtd_info *mtd)
 	return !!mtd->block_isbad;
 }
 
+static inline unsigned int mtd_bb_generation(struct mtd_info *mtd)
+{
+	if (mtd->master)
+		mtd = mtd->master;
+
+	if (mtd->get_bb_generation)
+		return mtd->get_bb_generation(mtd);
+
+	return mtd->bb_generation;
+}
+
 static inline uint32_t mtd_div_by_eb(uint64_t sz, struct mtd_info *mtd)
 {
 	do_div(sz, mtd->erasesize);
@@ -300,6 +300,7 @@ struct mci_host {
 	unsigned clock;		/**< Current clock used to talk to the card */
 	unsigned bus_width;	/**< used data bus width to the card */
 	unsigned max_req_size;
+	unsigned max_blk_count;	/**< max blocks per transfer, 0 for no limit */
 	unsigned dsr_val;	/**< optional dsr value */
 	int use_dsr;		/**< optional dsr usage flag */
 	bool non_removable;	/**< device is non removable */
@@ -311,6 +312,10 @@ struct mci_host {
 	void (*set_ios)(struct mci_host*, struct mci_ios *);
 	/** handle a command */
 	int (*send_cmd)(struct mci_host*, struct mci_cmd*, struct mci_data*);
+	/** start a command with data transfer, return without waiting for the data */
+	int (*submit)(struct mci_host*, struct mci_cmd*, struct mci_data*);
+	/** wait for the data transfer of a command started with submit */
+	int (*complete)(struct mci_host*, struct mci_cmd*, struct mci_data*);
 	/** check if a card is inserted */
 	int (*card_present)(struct mci_host *);
 	/** check if a card is write protected */
@@ -367,6 +372,13 @@ struct mci {
 
 	struct mci_part *part_curr;
 	u8 ext_csd_part_config;
+
+	struct list_head queue;		/**< queued asynchronous read requests */
+	int queue_len;
+	int queue_active;		/**< head of the queue is on the bus */
+	int queue_pos;			/**< blocks of the head already read */
+	struct mci_cmd queue_cmd;
+	struct mci_data queue_data;
 };
 
 int mci_register(struct mci_host*);
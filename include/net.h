@@ -418,6 +418,21 @@ struct eth_device *eth_get_byname(const char *name);
  */
 int net_receive(struct eth_device *edev, unsigned char *pkt, int len);
 
+/*
+ * Receive buffer ownership. Drivers allocating their receive buffers with
+ * net_rx_alloc_buf() pass them up with net_receive_buf(). A rx handler may
+ * then keep the buffer with net_rx_claim() and consume the data in place
+ * instead of copying it; it gives it back with net_rx_release().
+ */
+#define NET_RX_BUF_SIZE		2048
+#define NET_RX_MAX_CLAIMED	256
+
+void *net_rx_alloc_buf(void);
+void net_rx_free_buf(void *buf);
+void *net_receive_buf(struct eth_device *edev, void *buf, int len);
+int net_rx_claim(void *packet);
+void net_rx_release(void *packet);
+
 struct net_connection {
 	struct ethernet *et;
 	struct iphdr *ip;
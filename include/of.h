@@ -33,6 +33,7 @@ struct device_node {
 	struct list_head parent_list;
 	struct list_head list;
 	phandle phandle;
+	struct hlist_node phandle_hash;
 };
 
 struct of_device_id {
@@ -65,6 +66,11 @@ struct driver_d;
 int of_fix_tree(struct device_node *);
 
 int of_match(struct device_d *dev, struct driver_d *drv);
+void of_driver_index_add(struct driver_d *drv);
+void of_device_index_add(struct device_d *dev);
+void of_device_index_remove(struct device_d *dev);
+struct driver_d **of_driver_index_lookup(struct device_node *node);
+struct device_d **of_device_index_lookup(struct driver_d *drv);
 
 int of_add_initrd(struct device_node *root, resource_size_t start,
 		resource_size_t end);
@@ -100,6 +106,9 @@ void of_print_nodes(struct device_node *node, int indent);
 int of_probe(void);
 int of_parse_dtb(struct fdt_header *fdt);
 struct device_node *of_unflatten_dtb(const void *fdt);
+void of_free(void *ptr);
+void of_free_struct(void *ptr);
+void of_tree_changed(struct device_node *node);
 
 struct cdev;
 
@@ -141,6 +150,8 @@ extern struct device_node *of_find_node_with_property(
 
 extern struct device_node *of_new_node(struct device_node *parent,
 				const char *name);
+extern void of_link_node(struct device_node *node,
+				struct device_node *parent);
 extern struct device_node *of_create_node(struct device_node *root,
 					const char *path);
 extern void of_delete_node(struct device_node *node);
@@ -766,6 +777,7 @@ int of_device_disable_path(const char *path);
 
 phandle of_get_tree_max_phandle(struct device_node *root);
 phandle of_node_create_phandle(struct device_node *node);
+void of_node_set_phandle(struct device_node *node, phandle phandle);
 int of_set_property_to_child_phandle(struct device_node *node, char *prop_name);
 
 static inline struct device_node *of_find_root_node(struct device_node *node)
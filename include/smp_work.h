@@ -0,0 +1,67 @@
+#ifndef __SMP_WORK_H
+#define __SMP_WORK_H
+
+#include <linux/list.h>
+#include <linux/types.h>
+#include <string.h>
+
+/*
+ * A job for a secondary CPU. @fn must be pure computation: no drivers,
+ * no console output, no memory allocation and no pollers, as barebox
+ * itself only runs on the boot CPU and none of these are SMP safe.
+ */
+struct smp_work {
+	void (*fn)(struct smp_work *work);
+	volatile int done;
+};
+
+/* A secondary CPU as seen by the boot CPU, registered by the architecture */
+struct smp_work_cpu {
+	struct list_head list;
+	struct smp_work * volatile work;
+	void (*kick)(struct smp_work_cpu *cpu);
+	int id;
+};
+
+#define smp_work_mb()	__sync_synchronize()
+
+#ifdef CONFIG_SMP_WORK
+void smp_work_add_cpu(struct smp_work_cpu *cpu);
+int smp_work_secondary(struct smp_work_cpu *cpu);
+int smp_work_nr_cpus(void);
+int smp_work_queue(struct smp_work *work);
+void smp_work_wait(struct smp_work *work);
+void smp_work_range(void (*fn)(void *ctx, size_t start, size_t len),
+		void *ctx, size_t len, size_t align);
+void smp_memset(void *s, int c, size_t n);
+#else
+static inline int smp_work_nr_cpus(void)
+{
+	return 0;
+}
+
+static inline int smp_work_queue(struct smp_work *work)
+{
+	work->fn(work);
+	work->done = 1;
+
+	return 0;
+}
+
+static inline void smp_work_wait(struct smp_work *work)
+{
+}
+
+static inline void smp_work_range(void (*fn)(void *ctx, size_t start,
+		size_t len), void *ctx, size_t len, size_t align)
+{
+	fn(ctx, 0, len);
+}
+
+static inline void smp_memset(void *s, int c, size_t n)
+{
+	memset(s, c, n);
+}
+#endif
+
+#endif /* __SMP_WORK_H */
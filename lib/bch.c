@@ -336,9 +336,10 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 			      unsigned int *syn)
 {
 	int i, j, s;
-	unsigned int m;
+	unsigned int m, e, step;
 	uint32_t poly;
 	const int t = GF_T(bch);
+	const unsigned int n = GF_N(bch);
 
 	s = bch->ecc_bits;
 
@@ -354,8 +355,18 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 		s -= 32;
 		while (poly) {
 			i = deg(poly);
-			for (j = 0; j < 2*t; j += 2)
-				syn[j] ^= a_pow(bch, (j+1)*(i+s));
+			/*
+			 * walk exponents (j+1)*(i+s) mod n by repeated addition
+			 * instead of a multiply and modulo per syndrome
+			 */
+			e = i+s;
+			step = (2*e >= n) ? 2*e-n : 2*e;
+			for (j = 0; j < 2*t; j += 2) {
+				syn[j] ^= bch->a_pow_tab[e];
+				e += step;
+				if (e >= n)
+					e -= n;
+			}
 
 			poly ^= (1 << i);
 		}
@@ -32,6 +32,7 @@
 #include <driver.h>
 #include <errno.h>
 #include <malloc.h>
+#include <dma.h>
 #include <init.h>
 #include <linux/ctype.h>
 #include <linux/err.h>
@@ -569,6 +570,98 @@ out:
 	return ret;
 }
 
+/*
+ * Receive buffer pool. Drivers which can hand their receive buffers up
+ * the stack allocate them from here. Free buffers are kept in a simple
+ * list linked through their first word.
+ */
+static void *net_rx_free_list;
+static int net_rx_claimed;
+
+/* buffer currently passed up by net_receive_buf() and its replacement */
+static void *net_rx_buf;
+static void *net_rx_spare;
+
+void *net_rx_alloc_buf(void)
+{
+	void *buf = net_rx_free_list;
+
+	if (buf) {
+		net_rx_free_list = *(void **)buf;
+		return buf;
+	}
+
+	return dma_alloc(NET_RX_BUF_SIZE);
+}
+
+void net_rx_free_buf(void *buf)
+{
+	if (!buf)
+		return;
+
+	*(void **)buf = net_rx_free_list;
+	net_rx_free_list = buf;
+}
+
+/**
+ * net_receive_buf - Pass a receive buffer from the pool up the stack
+ * @edev: The device the packet was received on
+ * @buf: The buffer, allocated with net_rx_alloc_buf()
+ * @len: length of the packet
+ *
+ * Like net_receive(), but the protocol handler may keep the buffer with
+ * net_rx_claim(). Returns the buffer the driver should use for the next
+ * packet: @buf if it was not claimed, a fresh one from the pool if it was.
+ */
+void *net_receive_buf(struct eth_device *edev, void *buf, int len)
+{
+	void *old_buf = net_rx_buf, *old_spare = net_rx_spare;
+	void *ret = buf;
+
+	net_rx_buf = buf;
+	net_rx_spare = NULL;
+
+	net_receive(edev, buf, len);
+
+	if (!net_rx_buf)
+		ret = net_rx_spare;
+
+	net_rx_buf = old_buf;
+	net_rx_spare = old_spare;
+
+	return ret;
+}
+
+/**
+ * net_rx_claim - take over the buffer of a received packet
+ * @packet: The packet as passed to the rx handler
+ *
+ * Called from a rx handler which wants to keep the packet after it returns.
+ * On success the handler owns the buffer and must give it back with
+ * net_rx_release(). Returns 0 when the packet can't be claimed, in which
+ * case it is only valid until the handler returns.
+ */
+int net_rx_claim(void *packet)
+{
+	if (!packet || packet != net_rx_buf)
+		return 0;
+
+	if (net_rx_claimed >= NET_RX_MAX_CLAIMED)
+		return 0;
+
+	net_rx_spare = net_rx_alloc_buf();
+	net_rx_buf = NULL;
+	net_rx_claimed++;
+
+	return 1;
+}
+
+void net_rx_release(void *packet)
+{
+	net_rx_claimed--;
+	net_rx_free_buf(packet);
+}
+
 static struct device_d net_device = {
 	.name = "net",
 	.id = DEVICE_ID_SINGLE,